@@ -0,0 +1,798 @@
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <thread>
+#include "../src/lexer/lexer.h"
+#include "../src/parser/parser.h"
+#include "../src/interpreter/interpreter.h"
+#include "../src/cache/script_cache.h"
+#include "../src/canvas/scene.h"
+#include "../src/session/session.h"
+#include "../src/numeric/double_double.h"
+#include "corpus.h"
+#include "harness.h"
+
+namespace {
+
+    // Stands in for the graph engine: records how many primitives the
+    // interpreter submitted so graph sweeps can be timed without SDL.
+    class CountingCanvas : public Acalc::Canvas {
+        public:
+            void plot(float x, float y) override { ++points; ++drawn; sink += x + y; }
+            void line(float x1, float y1, float x2, float y2) override {
+                ++lines;
+                ++drawn;
+                if (!std::isfinite(x1) || !std::isfinite(y1) || !std::isfinite(x2) || !std::isfinite(y2)) ++unbounded;
+                sink += x1 + y1 + x2 + y2;
+            }
+            void polyline(std::vector<Acalc::Point> points) override {
+                ++polylines;
+                Acalc::Canvas::polyline(std::move(points));
+            }
+            void show() override {}
+            void hide() override {}
+            void clean() override { points = lines = 0; }
+            void exit() override {}
+
+            size_t points = 0;
+            size_t lines = 0;
+            size_t polylines = 0;
+            // Lines with an infinite or NaN end, which should never be drawn.
+            size_t unbounded = 0;
+            size_t drawn = 0;
+            float sink = 0;
+    };
+
+    std::vector<std::unique_ptr<Acalc::Stmt>> parseAll(const std::string& code) {
+        Acalc::Lexer lexer(code);
+        Acalc::Parser parser(lexer);
+        std::vector<std::unique_ptr<Acalc::Stmt>> stmts;
+        std::unique_ptr<Acalc::Stmt> stmt;
+        while ((stmt = parser.parse()) != nullptr) {
+            stmts.push_back(std::move(stmt));
+        }
+        return stmts;
+    }
+
+    // Parses `expr;` and returns the expression statement that owns it.
+    std::unique_ptr<Acalc::ExprStmt> parseExpr(const std::string& expr) {
+        auto stmts = parseAll(expr + ";");
+        return std::unique_ptr<Acalc::ExprStmt>(static_cast<Acalc::ExprStmt*>(stmts.front().release()));
+    }
+
+    void lexerBenchmarks(Bench::Suite& suite) {
+        Bench::Rng rng(1);
+        const std::pair<const char*, std::string> inputs[] = {
+            { "literal", Bench::literalExpr(rng, 20000) + ";" },
+            { "nested", Bench::nestedExpr(rng, 400) + ";" },
+            { "trig", Bench::trigExpr(rng, 2000) + ";" },
+            { "script", Bench::script(rng, 20000) },
+        };
+
+        for (const auto& [name, code] : inputs) {
+            double tokens = static_cast<double>(Acalc::Lexer(code).getTokens().size());
+            suite.run(std::string("lexer.getTokens/") + name, tokens, [&code]() {
+                Acalc::Lexer lexer(code);
+                auto tokens = lexer.getTokens();
+                Bench::keep(tokens.size());
+            });
+        }
+    }
+
+    void parserBenchmarks(Bench::Suite& suite) {
+        Bench::Rng rng(2);
+        const std::pair<const char*, std::string> inputs[] = {
+            { "literal", Bench::literalExpr(rng, 20000) + ";" },
+            { "nested", Bench::nestedExpr(rng, 400) + ";" },
+            { "script", Bench::script(rng, 20000) },
+        };
+
+        // The parser pulls tokens from the lexer, so this is the cost of the
+        // whole front end.
+        for (const auto& [name, code] : inputs) {
+            double stmts = static_cast<double>(parseAll(code).size());
+            suite.run(std::string("parser.parse/") + name, stmts, [&code]() {
+                Acalc::Lexer lexer(code);
+                Acalc::Parser parser(lexer);
+                while (parser.parse() != nullptr) {}
+            });
+        }
+    }
+
+    void interpreterBenchmarks(Bench::Suite& suite) {
+        Bench::Rng rng(3);
+        const std::pair<const char*, std::string> inputs[] = {
+            { "literal", Bench::literalExpr(rng, 64) },
+            { "deep_nested", Bench::nestedExpr(rng, 256) },
+            { "trig", Bench::trigExpr(rng, 16) },
+        };
+        const int evaluations = 10000;
+
+        for (const auto& [name, code] : inputs) {
+            auto stmt = parseExpr(code);
+            suite.run(std::string("interpreter.evaluate/") + name, evaluations, [&stmt, evaluations]() {
+                CountingCanvas canvas;
+                Acalc::Interpreter interpreter(canvas);
+                float sum = 0;
+                for (int i = 0; i < evaluations; ++i) {
+                    sum += interpreter.evaluate(stmt->getExpr());
+                }
+                Bench::keep(sum);
+            });
+        }
+
+        Bench::Rng scriptRng(4);
+        auto stmts = parseAll(Bench::script(scriptRng, 5000));
+        suite.run("interpreter.interpret/script", static_cast<double>(stmts.size()), [&stmts]() {
+            CountingCanvas canvas;
+            Acalc::Interpreter interpreter(canvas);
+            for (const auto& stmt : stmts) {
+                interpreter.interpret(stmt);
+            }
+        });
+    }
+
+    // `integ` uses a fixed number of samples, so accuracy is reported next
+    // to the time each integral took against its closed-form value.
+    void integBenchmarks(Bench::Suite& suite) {
+        const struct { const char* name; const char* expr; double exact; } cases[] = {
+            { "sin", "integ(sin(x), 0, pi)", 2.0 },
+            { "poly", "integ(x*x, 0, 1)", 1.0 / 3.0 },
+            { "atan", "integ(1/(1+x*x), 0, 1)", 0.78539816339744830962 },
+            { "log", "integ(log(x), 1, e)", 1.0 },
+            { "oscillating", "integ(x*sin(30*x), 0, tau)", -0.20943951023931954923 },
+        };
+
+        for (const auto& c : cases) {
+            auto stmt = parseExpr(c.expr);
+            suite.run(std::string("integ/") + c.name, 100000, [&stmt, &c](std::map<std::string, double>& metrics) {
+                CountingCanvas canvas;
+                Acalc::Interpreter interpreter(canvas);
+                double val = interpreter.evaluate(stmt->getExpr());
+                metrics["abs_error"] = std::abs(val - c.exact);
+            });
+        }
+    }
+
+    // integ over named variables: adaptive cubature up to three dimensions,
+    // quasi-Monte Carlo above. `est_error` is the estimate left in `err`.
+    void cubatureBenchmarks(Bench::Suite& suite) {
+        const struct { const char* name; const char* expr; double exact; } cases[] = {
+            { "gauss2d", "integ(e^(-(x^2+y^2)), x, -5, 5, y, -5, 5)", 3.1415926535801333 },
+            { "oscillating3d", "integ(sin(x*y*z)+cos(x+y+z), x, 0, 2, y, 0, 2, z, 0, 2)", -1.5984267080498435 },
+            { "sin5d", "integ(sin(a+b+c+d+f), a, 0, 1, b, 0, 1, c, 0, 1, d, 0, 1, f, 0, 1)", 0.48506478141104636 },
+            { "product8d", "integ(1/(1+a*b*c*d*f*g*h*i), a, 0, 1, b, 0, 1, c, 0, 1, d, 0, 1, f, 0, 1, g, 0, 1, h, 0, 1, i, 0, 1)", 0.9962330018526481 },
+        };
+
+        auto err = parseExpr("err");
+
+        for (const auto& c : cases) {
+            auto stmt = parseExpr(c.expr);
+            suite.run(std::string("integ.cubature/") + c.name, 1, [&stmt, &err, &c](std::map<std::string, double>& metrics) {
+                CountingCanvas canvas;
+                Acalc::Interpreter interpreter(canvas);
+                double val = interpreter.evaluate(stmt->getExpr());
+                metrics["abs_error"] = std::abs(val - c.exact);
+                metrics["est_error"] = interpreter.evaluate(err->getExpr());
+            });
+        }
+    }
+
+    void graphBenchmarks(Bench::Suite& suite) {
+        const std::pair<const char*, const char*> formulas[] = {
+            { "linear", "graph 2*x+3;" },
+            { "trig", "graph x*sin(300/(x*x));" },
+            { "heavy", "graph sin(x/10)*cos(x/7)+log(abs(x)+1)*tan(x/300);" },
+        };
+
+        for (const auto& [name, code] : formulas) {
+            auto stmts = parseAll(code);
+            CountingCanvas probe;
+            Acalc::Interpreter(probe).interpret(stmts.front());
+            suite.run(std::string("graph.sweep/") + name, static_cast<double>(probe.points), [&stmts]() {
+                CountingCanvas canvas;
+                Acalc::Interpreter interpreter(canvas);
+                interpreter.interpret(stmts.front());
+            });
+        }
+    }
+
+    // Re-issues the same integ and graph statements against one
+    // interpreter, so all but the first are answered from its memo cache.
+    void memoBenchmarks(Bench::Suite& suite) {
+        const std::pair<const char*, const char*> scripts[] = {
+            { "integ", "print integ(a*sin(x)*cos(x), 0, pi);" },
+            { "graph", "graph a*sin(x/10)*cos(x/7); clean;" },
+        };
+        const int repeats = 50;
+        auto setup = parseAll("var a = 2;");
+
+        for (const auto& [name, code] : scripts) {
+            auto stmts = parseAll(code);
+            suite.run(std::string("memo.repeat/") + name, repeats, [&](std::map<std::string, double>& metrics) {
+                CountingCanvas canvas;
+                Acalc::Interpreter interpreter(canvas);
+                std::streambuf* out = std::cout.rdbuf(nullptr);
+                for (const auto& stmt : setup) {
+                    interpreter.interpret(stmt);
+                }
+                for (int i = 0; i < repeats; ++i) {
+                    for (const auto& stmt : stmts) {
+                        interpreter.interpret(stmt);
+                    }
+                }
+                std::cout.rdbuf(out);
+                metrics["memo_misses"] = static_cast<double>(interpreter.memoStats().misses);
+            });
+        }
+    }
+
+    // Adaptive parametric and polar tracing; `segments` is the number of
+    // polyline segments submitted and `pieces` the number of polylines.
+    // The pole cases divide by zero at t = 0 and must come out broken into
+    // `pieces` finite polylines, so the run fails if they do not.
+    void parametricBenchmarks(Bench::Suite& suite) {
+        const struct { const char* name; const char* code; size_t pieces; } curves[] = {
+            { "lissajous", "pgraph 300*sin(13*t), 250*cos(17*t), 0, tau;", 0 },
+            { "rose", "polar 250*cos(12*t), 0, tau;", 0 },
+            { "spiral", "polar t/10, 0, 2000*pi;", 0 },
+            { "pole", "pgraph 100*t, 100/t, -1, 1;", 2 },
+            { "polar_pole", "polar 100/t, 0, tau;", 1 },
+        };
+
+        for (const auto& c : curves) {
+            auto stmts = parseAll(c.code);
+            CountingCanvas probe;
+            Acalc::Interpreter(probe).interpret(stmts.front());
+            if (c.pieces != 0 && (probe.polylines != c.pieces || probe.unbounded != 0)) {
+                throw std::runtime_error(std::string("graph.adaptive/") + c.name + " was not broken at its pole");
+            }
+            suite.run(std::string("graph.adaptive/") + c.name, static_cast<double>(probe.lines), [&stmts, &probe](std::map<std::string, double>& metrics) {
+                CountingCanvas canvas;
+                Acalc::Interpreter interpreter(canvas);
+                interpreter.interpret(stmts.front());
+                metrics["segments"] = static_cast<double>(probe.lines);
+                metrics["pieces"] = static_cast<double>(probe.polylines);
+            });
+        }
+    }
+
+    // Implicit curves over the whole window. "tan" cannot be bounded by
+    // interval arithmetic, so no cell is pruned and every pixel is sampled.
+    // "pole" divides by zero along x = 0, a line of the pixel grid, and
+    // fails the run unless it is traced with finite segments only.
+    void implicitBenchmarks(Bench::Suite& suite) {
+        const std::pair<const char*, const char*> curves[] = {
+            { "circle", "implicit x^2 + y^2 - 200^2;" },
+            { "lemniscate", "implicit (x^2+y^2)^2 - 2*250^2*(x^2-y^2);" },
+            { "degree10", "implicit x^10 + y^10 - 250^10;" },
+            { "waves", "implicit sin(x/20) - cos(y/20);" },
+            { "tan", "implicit tan(x/50) - y/50;" },
+            { "pole", "implicit y - 1000/x;" },
+        };
+
+        for (const auto& [name, code] : curves) {
+            auto stmts = parseAll(code);
+            CountingCanvas probe;
+            Acalc::Interpreter(probe).interpret(stmts.front());
+            if (probe.lines == 0 || probe.unbounded != 0) {
+                throw std::runtime_error(std::string("graph.implicit/") + name + " traced no finite curve");
+            }
+            suite.run(std::string("graph.implicit/") + name, static_cast<double>(probe.lines), [&stmts, &probe](std::map<std::string, double>& metrics) {
+                CountingCanvas canvas;
+                Acalc::Interpreter interpreter(canvas);
+                interpreter.interpret(stmts.front());
+                metrics["segments"] = static_cast<double>(probe.lines);
+            });
+        }
+    }
+
+    // Slider-style exploration with 24 curves on screen, 6 of which read
+    // `a`: "bound" redefines `a` and lets the live bindings resample, while
+    // "regraph" is the manual equivalent of clean, redefine and re-issue
+    // every graph. Each redefinition is drawn as its own frame.
+    void reactiveBenchmarks(Bench::Suite& suite) {
+        std::string setup = "var a = 1; var b = 1;";
+        for (int i = 0; i < 24; ++i) {
+            std::string k = std::to_string(i + 1);
+            setup += (i % 4 == 0)
+                ? " graph a*sin(x/" + k + ")*cos(x/7);"
+                : " graph b*sin(x/" + k + ")+log(abs(x)+" + k + ");";
+        }
+        const int frames = 20;
+
+        auto base = parseAll(setup);
+        std::vector<std::vector<std::unique_ptr<Acalc::Stmt>>> bound, regraph;
+        for (int i = 0; i < frames; ++i) {
+            std::string redefine = "var a = " + std::to_string(i + 2) + ";";
+            bound.push_back(parseAll(redefine));
+            regraph.push_back(parseAll("clean; " + redefine + setup.substr(setup.find("graph"))));
+        }
+
+        // The 24 graphs are drawn once, outside the timed body, so a run
+        // measures only the redefinitions and the frames they cause.
+        const std::pair<const char*, decltype(bound)*> modes[] = { { "bound", &bound }, { "regraph", &regraph } };
+        for (const auto& [name, scripts] : modes) {
+            std::string label = std::string("reactive.redefine/") + name;
+            if (!suite.enabled(label)) continue;
+
+            CountingCanvas canvas;
+            Acalc::Interpreter interpreter(canvas);
+            for (const auto& stmt : base) {
+                interpreter.interpret(stmt);
+            }
+            suite.run(label, frames, [&interpreter, scripts]() {
+                for (const auto& script : *scripts) {
+                    for (const auto& stmt : script) {
+                        interpreter.interpret(stmt);
+                    }
+                    interpreter.flush();
+                }
+            });
+        }
+    }
+
+    // A scene already holding a million points. "append" adds points one
+    // at a time and waits for each to reach the target; "curve" replaces
+    // one of 24 curves, which the target can only show by repainting.
+    // `forwarded` is the number of primitives the target received per
+    // operation.
+    void sceneBenchmarks(Bench::Suite& suite) {
+        if (!suite.enabled("scene.append/point") && !suite.enabled("scene.replace/curve")) return;
+
+        CountingCanvas target;
+        Acalc::Scene scene(target);
+        Bench::Rng rng(7);
+        for (int i = 0; i < 1000000; ++i) {
+            scene.plot(static_cast<float>(rng.next() % 800), static_cast<float>(rng.next() % 600));
+        }
+        std::vector<Acalc::Point> curve(16000);
+        for (size_t id = 0; id < 24; ++id) {
+            scene.curve(id, curve);
+        }
+        scene.sync();
+
+        const int appends = 1000;
+        suite.run("scene.append/point", appends, [&](std::map<std::string, double>& metrics) {
+            size_t before = target.drawn;
+            for (int i = 0; i < appends; ++i) {
+                scene.plot(static_cast<float>(i % 800), 300);
+                scene.sync();
+            }
+            metrics["forwarded"] = static_cast<double>(target.drawn - before) / appends;
+        });
+
+        suite.run("scene.replace/curve", 1, [&](std::map<std::string, double>& metrics) {
+            size_t before = target.drawn;
+            scene.curve(0, curve);
+            scene.sync();
+            metrics["forwarded"] = static_cast<double>(target.drawn - before);
+        });
+    }
+
+    // N sessions, each on its own thread, each running the same script
+    // against its own state. Throughput (items_per_second) should grow with
+    // N up to the number of cores, since sessions share nothing.
+    void sessionBenchmarks(Bench::Suite& suite) {
+        Bench::Rng rng(11);
+        std::string code = Bench::script(rng, 2000) + "\ngraph v1*sin(x/10);\nprint integ(sin(x)*v2, 0, pi);";
+        double statements = static_cast<double>(parseAll(code).size());
+
+        // Sessions run as the server runs them, one thread each with no
+        // workers of their own, so per-thread throughput should hold as
+        // threads are added up to the core count. Every session must print
+        // the same as a session alone, or they are sharing state.
+        Acalc::InterpreterOptions options;
+        options.workers = 1;
+        std::string expected;
+        {
+            std::ostringstream out;
+            Acalc::Session session(out, nullptr, options);
+            session.run(code);
+            expected = out.str();
+        }
+        double single = 0;
+
+        for (int threads : { 1, 2, 4, 8 }) {
+            suite.run("session.scaling/threads:" + std::to_string(threads), statements * threads,
+                      [&, threads](std::map<std::string, double>& metrics) {
+                std::vector<std::thread> workers;
+                std::vector<std::string> outputs(threads);
+                std::vector<double> seconds(threads);
+                for (int i = 0; i < threads; ++i) {
+                    workers.emplace_back([&, i]() {
+                        auto start = std::chrono::steady_clock::now();
+                        std::ostringstream out;
+                        Acalc::Session session(out, nullptr, options);
+                        session.run(code);
+                        outputs[i] = out.str();
+                        seconds[i] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                    });
+                }
+                for (std::thread& worker : workers) {
+                    worker.join();
+                }
+                for (const std::string& output : outputs) {
+                    if (output != expected) {
+                        throw std::runtime_error("concurrent sessions printed different output");
+                    }
+                }
+
+                double slowest = *std::max_element(seconds.begin(), seconds.end());
+                double perThread = statements / slowest;
+                if (threads == 1) single = perThread;
+                metrics["cores"] = std::max(1u, std::thread::hardware_concurrency());
+                metrics["per_thread_per_second"] = perThread;
+                metrics["efficiency"] = single > 0 ? perThread / single : 0;
+            });
+        }
+    }
+
+    // Mirrors read() in main.cpp: load the script, then either lex and parse
+    // it or replay its precompiled cache, executing every statement.
+    size_t runScript(const std::string& path, bool useCache) {
+        std::ifstream file(path, std::ios::binary);
+
+        CountingCanvas canvas;
+        Acalc::Interpreter interpreter(canvas);
+        size_t count = 0;
+
+        if (!useCache) {
+            Acalc::Lexer lexer(file);
+            Acalc::Parser parser(lexer);
+            std::unique_ptr<Acalc::Stmt> stmt;
+            while ((stmt = parser.parse()) != nullptr) {
+                interpreter.interpret(stmt);
+                ++count;
+            }
+            return count;
+        }
+
+        uint64_t hash = Acalc::fnv1a(file);
+        std::string cachePath = Acalc::ScriptCache::pathFor(path);
+        Acalc::ScriptCache cache;
+        if (!cache.open(cachePath, hash)) {
+            file.clear();
+            file.seekg(0);
+            if (!Acalc::ScriptCache::build(file, hash, cachePath) || !cache.open(cachePath, hash)) {
+                throw std::runtime_error("could not build script cache " + cachePath);
+            }
+        }
+        std::unique_ptr<Acalc::Stmt> stmt;
+        while ((stmt = cache.next()) != nullptr) {
+            interpreter.interpret(stmt);
+            ++count;
+        }
+        return count;
+    }
+
+    void cacheBenchmarks(Bench::Suite& suite) {
+        if (!suite.enabled("cache.startup/")) return;
+
+        const int statements = 100000;
+        auto path = (std::filesystem::temp_directory_path() / "acalc_bench_startup.acalc").string();
+        auto cachePath = Acalc::ScriptCache::pathFor(path);
+        {
+            Bench::Rng rng(5);
+            std::ofstream file(path);
+            file << Bench::script(rng, statements);
+        }
+
+        suite.run("cache.startup/uncached", statements, [&path]() {
+            Bench::keep(runScript(path, false));
+        });
+        suite.run("cache.startup/cold", statements, [&path, &cachePath]() {
+            std::filesystem::remove(cachePath);
+            Bench::keep(runScript(path, true));
+        });
+        suite.run("cache.startup/warm", statements, [&path]() {
+            Bench::keep(runScript(path, true));
+        });
+
+        std::filesystem::remove(cachePath);
+        std::filesystem::remove(path);
+    }
+
+    // Double-double kernels against 40-digit references, and what each
+    // costs next to the same function in double. Errors are relative.
+    void precisionBenchmarks(Bench::Suite& suite) {
+        using Acalc::DD;
+        struct Case { const char* a; const char* b; const char* exact; };
+        // `cases` are timed against double; `edges` (huge arguments,
+        // overflow and underflow) are only checked.
+        const struct {
+            const char* name;
+            DD (*dd)(const DD&, const DD&);
+            double (*fp)(double, double);
+            std::vector<Case> cases;
+            std::vector<Case> edges;
+        } kernels[] = {
+            { "sin", [](const DD& a, const DD&) { return Acalc::sin(a); }, [](double a, double) { return std::sin(a); }, {
+                { "0.5", "0", "0.4794255386042030002732879352155713880818" },
+                { "1", "0", "0.8414709848078965066525023216302989996226" },
+                { "2.5", "0", "0.5984721441039564940518547021861622717036" },
+                { "3", "0", "0.1411200080598672221007448028081102798469" },
+                { "10.25", "0", "-0.7346984304047954280743390779625001340479" },
+                { "-7.75", "0", "-0.9945987791111761206190108016397911055318" },
+                { "100.125", "0", "-0.3949054323786691181710669438942079436034" },
+                { "0.001", "0", "0.0009999998333333416666664682539710097001513" },
+            }, {
+                { "1e22", "0", "-0.8522008497671888017727058937530293682618" },
+                { "-1e22", "0", "0.8522008497671888017727058937530293682618" },
+                { "123456789012345678901234567890", "0", "0.9640769308796986260027814932794282417085" },
+                { "3.14159265358979323846264338327950288", "0", "-2.994769809718339554641594267875450189973e-33" },
+            } },
+            { "cos", [](const DD& a, const DD&) { return Acalc::cos(a); }, [](double a, double) { return std::cos(a); }, {
+                { "0.5", "0", "0.8775825618903727161162815826038296519916" },
+                { "1", "0", "0.5403023058681397174009366074429766037323" },
+                { "2.5", "0", "-0.8011436155469337148335027904673516644286" },
+                { "3", "0", "-0.9899924966004454572715727947312613023937" },
+                { "10.25", "0", "-0.6783938504738452955144136474671591474305" },
+                { "-7.75", "0", "0.1037943572192529710276940677138230370399" },
+                { "100.125", "0", "0.9187217747924647902357219915097363202666" },
+                { "0.001", "0", "0.9999995000000416666652777778025793648038" },
+            }, {
+                { "1e22", "0", "0.5232147853951389454975944733847094921409" },
+                { "1000000000000000", "0", "-0.5131937377869702522345361364231649295882" },
+                { "123456789012345678901234567890", "0", "-0.2656231754677682447010952445222090094720" },
+            } },
+            { "tan", [](const DD& a, const DD&) { return Acalc::tan(a); }, [](double a, double) { return std::tan(a); }, {
+                { "0.5", "0", "0.5463024898437905132551794657802853832976" },
+                { "1", "0", "1.557407724654902230506974807458360173087" },
+                { "1.25", "0", "3.009569673862831288157563894386243931392" },
+                { "-0.75", "0", "-0.9315964599440724611652027565739364281887" },
+                { "3", "0", "-0.1425465430742778052956354105339134932261" },
+                { "10.25", "0", "1.082996890215945275135930985916637983213" },
+            }, {
+                { "1e22", "0", "-1.628778225606898878549375936939548513545" },
+                { "3.14159265358979323846264338327950288", "0", "2.994769809718339554641594267875450189973e-33" },
+            } },
+            { "exp", [](const DD& a, const DD&) { return Acalc::exp(a); }, [](double a, double) { return std::exp(a); }, {
+                { "0.5", "0", "1.648721270700128146848650787814163571654" },
+                { "1", "0", "2.718281828459045235360287471352662497757" },
+                { "-1", "0", "0.3678794411714423215955237701614608674458" },
+                { "10.5", "0", "36315.50267424663773891202690131661796893" },
+                { "-20.25", "0", "1.605228055185611608653934309109539657171e-9" },
+                { "100", "0", "2.688117141816135448412625551580013587361e+43" },
+                { "0.001", "0", "1.001000500166708341668055753993058311563" },
+                { "250.75", "0", "7.931244481140790963364323106069423474687e+108" },
+            }, {
+                { "-600", "0", "2.650396553004310816338679447269582701529e-261" },
+                { "700", "0", "1.014232054735004509455329595231267615205e+304" },
+                { "710", "0", "inf" },
+                { "-800", "0", "0" },
+            } },
+            { "log", [](const DD& a, const DD&) { return Acalc::log(a); }, [](double a, double) { return std::log(a); }, {
+                { "0.5", "0", "-0.6931471805599453094172321214581765680755" },
+                { "2", "0", "0.6931471805599453094172321214581765680755" },
+                { "10", "0", "2.302585092994045684017991454684364207601" },
+                { "0.001", "0", "-6.907755278982137052053974364053092622803" },
+                { "123.456", "0", "4.815884817283263883109232105166525577172" },
+                { "1.0001", "0", "0.00009999500033330833533316668095113106348206" },
+                { "7", "0", "1.945910149055313305105352743443179729637" },
+                { "99999.5", "0", "11.51292046495772837842313435613015176716" },
+            } },
+            { "pow", [](const DD& a, const DD& b) { return Acalc::pow(a, b); }, [](double a, double b) { return std::pow(a, b); }, {
+                { "2", "0.5", "1.414213562373095048801688724209698078570" },
+                { "3.5", "2.25", "16.75533439837541080601892842623379757777" },
+                { "10", "-3.5", "0.0003162277660168379331998893544432718533720" },
+                { "1.5", "40", "11057332.32094001214227318996563553810120" },
+                { "0.9", "100.5", "0.00002519835549751173606162487442397570498635" },
+                { "7", "13", "96889010407" },
+            }, {
+                { "2", "-1074", "4.940656458412465441765687928682213723651e-324" },
+                { "0.5", "1050", "8.289046058458094980903836776809409499985e-317" },
+                { "2", "-1100", "0" },
+                { "10", "-400", "0" },
+                { "10", "400", "inf" },
+                { "2", "1024.5", "inf" },
+                { "2", "-1100.5", "0" },
+            } },
+        };
+        const int repeats = 1000;
+        // The README promises about 31 digits; results that overflow or
+        // underflow must do so exactly.
+        const double bound = 1e-29;
+
+        for (const auto& k : kernels) {
+            double worst = 0;
+            for (const auto* list : { &k.cases, &k.edges }) {
+                for (const auto& c : *list) {
+                    constexpr double inf = std::numeric_limits<double>::infinity();
+                    DD v = k.dd(DD::parse(c.a), DD::parse(c.b));
+                    DD exact = std::strcmp(c.exact, "inf") == 0 ? DD(inf) : DD::parse(c.exact);
+                    double error = exact.hi == 0 || std::isinf(exact.hi) ? (v == exact ? 0 : inf)
+                                                                         : std::abs(((v - exact) / exact).hi);
+                    if (!(error <= bound)) {
+                        std::ostringstream message;
+                        message << "precision.dd/" << k.name << " is off by " << error << " at " << c.a << ", " << c.b
+                                << ": " << v.format();
+                        throw std::runtime_error(message.str());
+                    }
+                    worst = std::max(worst, error);
+                }
+            }
+
+            std::vector<DD> as, bs;
+            for (const auto& c : k.cases) {
+                as.push_back(DD::parse(c.a));
+                bs.push_back(DD::parse(c.b));
+            }
+            double items = static_cast<double>(repeats * as.size());
+
+            suite.run(std::string("precision.dd/") + k.name, items, [&](std::map<std::string, double>& metrics) {
+                auto start = std::chrono::steady_clock::now();
+                for (int r = 0; r < repeats; ++r) {
+                    for (size_t i = 0; i < as.size(); ++i) {
+                        Bench::keep(k.dd(as[i], bs[i]).hi);
+                    }
+                }
+                auto wide = std::chrono::steady_clock::now() - start;
+
+                start = std::chrono::steady_clock::now();
+                for (int r = 0; r < repeats; ++r) {
+                    for (size_t i = 0; i < as.size(); ++i) {
+                        Bench::keep(k.fp(as[i].hi, bs[i].hi));
+                    }
+                }
+                auto narrow = std::chrono::steady_clock::now() - start;
+
+                metrics["max_rel_error"] = worst;
+                metrics["vs_double"] = std::chrono::duration<double>(wide).count() / std::chrono::duration<double>(narrow).count();
+            });
+        }
+
+        // Literals must parse to the nearest double-double: hi the nearest
+        // double and lo the nearest to what hi leaves over.
+        const struct { const char* text; double hi; double lo; } literals[] = {
+            { "0.1", 0x1.999999999999ap-4, -0x1.999999999999ap-58 },
+            { "0.3", 0x1.3333333333333p-2, 0x1.999999999999ap-57 },
+            { "3.14159265358979323846264338327950288", 0x1.921fb54442d18p+1, 0x1.1a62633145c07p-53 },
+            { "123456789.123456789123456789", 0x1.d6f34547e6b75p+26, -0x1.07dbd43400720p-29 },
+            { "0.000123456789012345678901234567890123", 0x1.02e85be180b74p-13, 0x1.1f3a8c5fba403p-67 },
+            { "1e300", 0x1.7e43c8800759cp+996, -0x1.698fdc7ace0cap+942 },
+        };
+        for (const auto& literal : literals) {
+            DD v = DD::parse(literal.text);
+            if (v.hi != literal.hi || v.lo != literal.lo) {
+                throw std::runtime_error(std::string("DD::parse rounds ") + literal.text + " wrongly");
+            }
+        }
+        suite.run("precision.dd/parse", static_cast<double>(std::size(literals)), [&literals]() {
+            for (const auto& literal : literals) {
+                Bench::keep(DD::parse(literal.text).hi);
+            }
+        });
+
+        // Whole expressions through the compiled program, in both modes.
+        Bench::Rng rng(6);
+        auto stmt = parseExpr(Bench::trigExpr(rng, 16));
+        const int evaluations = 10000;
+        CountingCanvas canvas;
+        Acalc::Interpreter interpreter(canvas);
+        Acalc::Program program = interpreter.compile(stmt->getExpr());
+
+        suite.run("precision.float/trig", evaluations, [&program, evaluations]() {
+            std::vector<float> stack;
+            float sum = 0;
+            for (int i = 0; i < evaluations; ++i) {
+                sum += program.run(stack);
+            }
+            Bench::keep(sum);
+        });
+        suite.run("precision.dd/trig", evaluations, [&program, evaluations](std::map<std::string, double>& metrics) {
+            std::vector<DD> wideStack;
+            std::vector<float> stack;
+            DD sum;
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < evaluations; ++i) {
+                sum += program.runDD(wideStack);
+            }
+            auto wide = std::chrono::steady_clock::now() - start;
+
+            float narrowSum = 0;
+            start = std::chrono::steady_clock::now();
+            for (int i = 0; i < evaluations; ++i) {
+                narrowSum += program.run(stack);
+            }
+            auto narrow = std::chrono::steady_clock::now() - start;
+
+            Bench::keep(sum.hi + narrowSum);
+            metrics["vs_float"] = std::chrono::duration<double>(wide).count() / std::chrono::duration<double>(narrow).count();
+        });
+    }
+
+    // A table written to a file, against the same rows printed one at a
+    // time the way `print` does, through operator<< and std::endl.
+    void tableBenchmarks(Bench::Suite& suite) {
+        if (!suite.enabled("table.write/")) return;
+
+        const uint64_t rows = uint64_t(1) << 20;
+        const double step = 1.0 / (rows - 1);
+        auto path = (std::filesystem::temp_directory_path() / "acalc_bench_table.csv").string();
+        auto stmt = parseExpr("x*sin(x)");
+        ::Environment env;
+        ::Environment::Slot* x = &env.slot("x");
+        Acalc::Program program;
+        Acalc::Compiler(env).compile(stmt->getExpr(), program);
+
+        suite.run("table.write/print", static_cast<double>(rows), [&]() {
+            std::ofstream file(path);
+            std::vector<float> stack;
+            for (uint64_t i = 0; i < rows; ++i) {
+                x->set(static_cast<float>(i * step));
+                file << x->value << ',' << program.run(stack) << std::endl;
+            }
+        });
+        suite.run("table.write/file", static_cast<double>(rows), [&](std::map<std::string, double>& metrics) {
+            {
+                std::ofstream file(path, std::ios::binary);
+                Acalc::Table::write(program, x, 0, step, rows, file);
+            }
+            metrics["bytes_per_row"] = static_cast<double>(std::filesystem::file_size(path)) / rows;
+        });
+
+        std::filesystem::remove(path);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t runs = 7;
+    std::string filter;
+    std::string out;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--runs") && i + 1 < argc) {
+            runs = std::max(1, std::atoi(argv[++i]));
+        } else if (!std::strcmp(argv[i], "--filter") && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (!std::strcmp(argv[i], "--out") && i + 1 < argc) {
+            out = argv[++i];
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--runs N] [--filter SUBSTRING] [--out FILE.json]" << std::endl;
+            return 2;
+        }
+    }
+
+    Bench::Suite suite(runs, filter);
+
+    try {
+        lexerBenchmarks(suite);
+        parserBenchmarks(suite);
+        interpreterBenchmarks(suite);
+        integBenchmarks(suite);
+        cubatureBenchmarks(suite);
+        graphBenchmarks(suite);
+        parametricBenchmarks(suite);
+        implicitBenchmarks(suite);
+        memoBenchmarks(suite);
+        reactiveBenchmarks(suite);
+        sceneBenchmarks(suite);
+        sessionBenchmarks(suite);
+        cacheBenchmarks(suite);
+        precisionBenchmarks(suite);
+        tableBenchmarks(suite);
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    } catch (const std::string& err) {
+        std::cerr << err << std::endl;
+        return 1;
+    } catch (const char* err) {
+        std::cerr << err << std::endl;
+        return 1;
+    }
+
+    if (out.empty()) {
+        suite.writeJson(std::cout);
+    } else {
+        std::ofstream file(out);
+        suite.writeJson(file);
+    }
+
+    return 0;
+}
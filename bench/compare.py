@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Compare an acalc_bench JSON report against a stored baseline.
+
+    compare.py BASELINE.json CURRENT.json [--threshold 0.10]
+
+A benchmark regresses when its median time grows by more than the threshold
+(a fraction, 0.10 = 10%). Accuracy metrics such as `abs_error` regress when
+they grow by more than the threshold and by more than --abs-tolerance.
+Exits with status 1 when any regression is found.
+"""
+
+import argparse
+import json
+import sys
+
+TIME_KEYS = ("median_ns",)
+SKIP_KEYS = ("name", "runs", "median_ns", "min_ns", "items_per_second")
+
+
+def load(path):
+    with open(path) as f:
+        return {b["name"]: b for b in json.load(f)["benchmarks"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.10)
+    parser.add_argument("--abs-tolerance", type=float, default=1e-9)
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+    regressions = 0
+
+    for name in sorted(set(baseline) | set(current)):
+        if name not in current:
+            print(f"MISSING    {name}")
+            continue
+        if name not in baseline:
+            print(f"NEW        {name}")
+            continue
+
+        old, new = baseline[name], current[name]
+        for key in TIME_KEYS:
+            ratio = new[key] / old[key] if old[key] else 1.0
+            status = "REGRESSED" if ratio > 1.0 + args.threshold else "ok"
+            regressions += status != "ok"
+            print(f"{status:<10} {name:<40} {key} {old[key]:>14.0f} -> {new[key]:>14.0f} ({ratio - 1.0:+.1%})")
+
+        for key in sorted(set(old) & set(new)):
+            if key in SKIP_KEYS or old[key] is None or new[key] is None:
+                continue
+            grew = new[key] - old[key]
+            if grew > args.abs_tolerance and grew > abs(old[key]) * args.threshold:
+                regressions += 1
+                print(f"REGRESSED  {name:<40} {key} {old[key]:.6g} -> {new[key]:.6g}")
+
+    if regressions:
+        print(f"{regressions} regression(s) beyond {args.threshold:.0%}")
+        return 1
+    print("no regressions")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
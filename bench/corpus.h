@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Deterministic input generator for acalc_bench. Everything is derived from
+// a SplitMix64 stream rather than <random> distributions so that the same
+// seed produces byte-identical corpora on every platform and standard library.
+
+namespace Bench {
+
+    class Rng {
+        public:
+            Rng(uint64_t seed) : state{seed} {}
+
+            uint64_t next() {
+                uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                return z ^ (z >> 31);
+            }
+
+            int below(int n) { return static_cast<int>(next() % static_cast<uint64_t>(n)); }
+
+        private:
+            uint64_t state;
+    };
+
+    inline std::string number(Rng& rng) {
+        std::string num = std::to_string(1 + rng.below(999));
+        if (rng.below(2)) {
+            num += "." + std::to_string(rng.below(100));
+        }
+        return num;
+    }
+
+    inline const char* binaryOp(Rng& rng) {
+        static const char* ops[] = { "+", "-", "*", "/" };
+        return ops[rng.below(4)];
+    }
+
+    // A flat chain of numeric literals: "12.5+7*3.25-...".
+    inline std::string literalExpr(Rng& rng, int terms) {
+        std::string expr = number(rng);
+        for (int i = 1; i < terms; ++i) {
+            expr += binaryOp(rng);
+            expr += number(rng);
+        }
+        return expr;
+    }
+
+    // Right-nested parentheses "(1+(2*(3-(...))))" of the given depth.
+    inline std::string nestedExpr(Rng& rng, int depth) {
+        std::string expr;
+        for (int i = 0; i < depth; ++i) {
+            expr += "(" + number(rng) + "+";
+        }
+        expr += "x";
+        expr.append(depth, ')');
+        return expr;
+    }
+
+    // Sums of trigonometric/logarithmic calls over x.
+    inline std::string trigExpr(Rng& rng, int terms) {
+        static const char* funcs[] = { "sin", "cos", "tan", "log", "abs" };
+        std::string expr;
+        for (int i = 0; i < terms; ++i) {
+            if (i > 0) {
+                expr += "+";
+            }
+            const char* outer = funcs[rng.below(2)];
+            const char* inner = funcs[rng.below(5)];
+            if (inner[0] == 'l') {
+                expr += std::string(outer) + "(log(abs(x)+" + number(rng) + "))";
+            } else {
+                expr += std::string(outer) + "(" + inner + "(x*" + number(rng) + ")" + binaryOp(rng) + number(rng) + ")";
+            }
+        }
+        return expr;
+    }
+
+    // A script of `var` declarations and expression statements. Only
+    // statements that produce no output are generated so that timing the
+    // interpreter never measures the console.
+    inline std::string script(Rng& rng, int statements) {
+        std::string code;
+        for (int i = 0; i < statements; ++i) {
+            if (i > 0) {
+                code += "\n";
+            }
+            switch (rng.below(4)) {
+                case 0: code += "var v" + std::to_string(i % 64) + " = " + literalExpr(rng, 4) + ";"; break;
+                case 1: code += literalExpr(rng, 8) + ";"; break;
+                case 2: code += nestedExpr(rng, 6) + ";"; break;
+                default: code += trigExpr(rng, 2) + ";"; break;
+            }
+        }
+        return code;
+    }
+}
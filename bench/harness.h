@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Minimal benchmark harness for acalc_bench. Each benchmark body performs
+// one complete unit of work; the harness repeats it and records wall time
+// per run, reporting the median (used for regression checks) and minimum.
+
+namespace Bench {
+
+    // Keeps a computed value observable so the optimiser cannot drop the
+    // work that produced it. GCC and Clang get an empty asm statement that
+    // claims to read the value; elsewhere it goes through a volatile.
+    template <typename T>
+    void keep(const T& val) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(val) : "memory");
+#else
+        static volatile T sink;
+        sink = val;
+        T read = sink;
+        (void)read;
+#endif
+    }
+
+    struct Result {
+        std::string name;
+        size_t runs;
+        double median_ns;
+        double min_ns;
+        double items_per_second;
+        std::map<std::string, double> metrics;
+    };
+
+    class Suite {
+        public:
+            Suite(size_t runs, const std::string& filter) : runs{runs}, filter{filter} {}
+
+            bool enabled(const std::string& name) const {
+                return filter.empty() || name.find(filter) != std::string::npos;
+            }
+
+            // `items` is the amount of work one run of `body` represents
+            // (tokens, statements, samples...) and feeds items_per_second.
+            // `body` may fill in extra metrics such as accuracy figures.
+            void run(const std::string& name, double items, const std::function<void(std::map<std::string, double>&)>& body) {
+                if (!enabled(name)) return;
+
+                std::map<std::string, double> metrics;
+                body(metrics);
+
+                std::vector<double> samples;
+                for (size_t i = 0; i < runs; ++i) {
+                    auto start = std::chrono::steady_clock::now();
+                    body(metrics);
+                    auto end = std::chrono::steady_clock::now();
+                    samples.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+                }
+                std::sort(samples.begin(), samples.end());
+
+                double median = samples[samples.size() / 2];
+                results.push_back({ name, runs, median, samples.front(), median > 0 ? items * 1e9 / median : 0, metrics });
+
+                std::fprintf(stderr, "%-40s %14.0f ns %14.0f items/s\n", name.c_str(), median, results.back().items_per_second);
+            }
+
+            void run(const std::string& name, double items, const std::function<void()>& body) {
+                run(name, items, [&body](std::map<std::string, double>&) { body(); });
+            }
+
+            void writeJson(std::ostream& out) const {
+                out << "{\n  \"format\": 1,\n  \"benchmarks\": [\n";
+                for (size_t i = 0; i < results.size(); ++i) {
+                    const Result& r = results[i];
+                    out << "    {\"name\": \"" << r.name << "\""
+                        << ", \"runs\": " << r.runs
+                        << ", \"median_ns\": " << number(r.median_ns)
+                        << ", \"min_ns\": " << number(r.min_ns)
+                        << ", \"items_per_second\": " << number(r.items_per_second);
+                    for (const auto& [key, val] : r.metrics) {
+                        out << ", \"" << key << "\": " << number(val);
+                    }
+                    out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+                }
+                out << "  ]\n}\n";
+            }
+
+        private:
+            static std::string number(double val) {
+                if (!std::isfinite(val)) return "null";
+                char buf[32];
+                std::snprintf(buf, sizeof buf, "%.9g", val);
+                return buf;
+            }
+
+        private:
+            size_t runs;
+            std::string filter;
+            std::vector<Result> results;
+    };
+}
@@ -0,0 +1,178 @@
+// Load generator for `Acalc --serve PATH`. Opens several connections,
+// keeps a fixed number of requests in flight on each and reports the
+// latency distribution and throughput.
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "../src/server/protocol.h"
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        std::string socket;
+        int connections = 8;
+        int requests = 1000;
+        int pipeline = 4;
+        std::string script = "var a = 2; print a * sin(pi / 4) + a ^ 0.5;";
+    };
+
+    struct Stats {
+        std::vector<double> latencies;
+        size_t failed = 0;
+        std::string error;
+    };
+
+    int connectTo(const std::string& path) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof addr.sun_path) return -1;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0) {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    bool writeAll(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // One connection: sends `requests` frames, at most `pipeline` ahead of
+    // the responses, and times each from send to response.
+    void client(const Options& options, Stats& stats) {
+        int fd = connectTo(options.socket);
+        if (fd < 0) {
+            stats.error = "cannot connect to " + options.socket;
+            return;
+        }
+
+        std::string frame;
+        Acalc::Protocol::appendFrame(frame, options.script);
+
+        std::deque<Clock::time_point> inFlight;
+        std::string in;
+        char buffer[64 * 1024];
+        int sent = 0;
+        int received = 0;
+
+        while (received < options.requests) {
+            std::string batch;
+            while (sent < options.requests && static_cast<int>(inFlight.size()) < options.pipeline) {
+                batch += frame;
+                inFlight.push_back(Clock::now());
+                ++sent;
+            }
+            if (!batch.empty() && !writeAll(fd, batch)) {
+                stats.error = "connection lost while sending";
+                break;
+            }
+
+            ssize_t n = ::recv(fd, buffer, sizeof buffer, 0);
+            if (n <= 0) {
+                stats.error = "connection closed by the server";
+                break;
+            }
+            in.append(buffer, static_cast<size_t>(n));
+
+            std::string_view rest = in;
+            std::string_view payload;
+            size_t consumed = 0;
+            while (Acalc::Protocol::nextFrame(rest, payload, consumed) == Acalc::Protocol::COMPLETE) {
+                auto now = Clock::now();
+                stats.latencies.push_back(std::chrono::duration<double, std::milli>(now - inFlight.front()).count());
+                inFlight.pop_front();
+                if (payload.empty() || payload[0] != Acalc::Protocol::OK) ++stats.failed;
+                ++received;
+                rest.remove_prefix(consumed);
+            }
+            in.erase(0, in.size() - rest.size());
+        }
+
+        ::close(fd);
+    }
+
+    double percentile(const std::vector<double>& sorted, double p) {
+        if (sorted.empty()) return 0;
+        size_t i = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+        return sorted[std::min(i, sorted.size() - 1)];
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--socket") && i + 1 < argc) {
+            options.socket = argv[++i];
+        } else if (!std::strcmp(argv[i], "--connections") && i + 1 < argc) {
+            options.connections = std::max(1, std::atoi(argv[++i]));
+        } else if (!std::strcmp(argv[i], "--requests") && i + 1 < argc) {
+            options.requests = std::max(1, std::atoi(argv[++i]));
+        } else if (!std::strcmp(argv[i], "--pipeline") && i + 1 < argc) {
+            options.pipeline = std::max(1, std::atoi(argv[++i]));
+        } else if (!std::strcmp(argv[i], "--script") && i + 1 < argc) {
+            options.script = argv[++i];
+        } else {
+            options.socket.clear();
+            break;
+        }
+    }
+
+    if (options.socket.empty()) {
+        std::cerr << "usage: " << argv[0] << " --socket PATH [--connections N] [--requests N]"
+                  << " [--pipeline DEPTH] [--script CODE]" << std::endl;
+        return 2;
+    }
+
+    std::vector<Stats> stats(options.connections);
+    std::vector<std::thread> clients;
+
+    auto start = Clock::now();
+    for (Stats& s : stats) {
+        clients.emplace_back(client, std::cref(options), std::ref(s));
+    }
+    for (std::thread& c : clients) {
+        c.join();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<double> latencies;
+    size_t failed = 0;
+    for (const Stats& s : stats) {
+        if (!s.error.empty()) {
+            std::cerr << "Error: " << s.error << std::endl;
+        }
+        latencies.insert(latencies.end(), s.latencies.begin(), s.latencies.end());
+        failed += s.failed;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    std::cout << "connections  " << options.connections << " x pipeline " << options.pipeline << "\n"
+              << "requests     " << latencies.size() << " (" << failed << " failed)\n"
+              << "elapsed      " << elapsed << " s\n"
+              << "throughput   " << (elapsed > 0 ? latencies.size() / elapsed : 0) << " req/s\n"
+              << "latency p50  " << percentile(latencies, 0.50) << " ms\n"
+              << "latency p99  " << percentile(latencies, 0.99) << " ms\n"
+              << "latency max  " << (latencies.empty() ? 0 : latencies.back()) << " ms" << std::endl;
+
+    return latencies.size() == static_cast<size_t>(options.connections) * options.requests && failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,495 @@
+#include "script_cache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include "../lexer/lexer.h"
+#include "../parser/parser.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Acalc {
+
+    namespace {
+
+        enum CacheOp : uint8_t {
+            OP_LITERAL, OP_IDENTIFIER, OP_UNARY, OP_BINARY, OP_INTEG, OP_MULTI_INTEG,
+
+            OP_EXPR_STMT, OP_PRINT, OP_VAR, OP_VAR_INIT,
+            OP_GRAPH, OP_PGRAPH, OP_POLAR, OP_IMPLICIT, OP_PLOT, OP_LINE,
+            OP_SHOW, OP_HIDE, OP_CLEAR, OP_CLEAN, OP_EXIT, OP_PRECISION,
+            OP_TABLE,
+
+            OP_ERROR
+        };
+
+        struct Header {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t source_hash;
+            uint64_t payload_size;
+            uint64_t payload_hash;
+        };
+
+        const char* spelling(TokenType type) {
+            switch (type) {
+                case TOKEN_MINUS: return "-";
+                case TOKEN_PLUS: return "+";
+                case TOKEN_SLASH: return "/";
+                case TOKEN_STAR: return "*";
+                case TOKEN_POWER: return "^";
+                case TOKEN_SIN: return "sin";
+                case TOKEN_COS: return "cos";
+                case TOKEN_TAN: return "tan";
+                case TOKEN_COSEC: return "cosec";
+                case TOKEN_SEC: return "sec";
+                case TOKEN_COT: return "cot";
+                case TOKEN_LOG: return "log";
+                case TOKEN_ABS: return "abs";
+                default: return "";
+            }
+        }
+
+        // Statements are visited directly; their expressions are walked in
+        // post-order, so each expression visit only writes its own node.
+        class CacheWriter : public ExprVisitor, public StmtVisitor {
+            public:
+                CacheWriter(const std::string& path) : out{path, std::ios::binary} {
+                    Header header{};
+                    out.write(reinterpret_cast<const char*>(&header), sizeof header);
+                }
+
+                bool good() const { return out.good(); }
+
+                void write(Stmt* stmt) { stmt->accept(this); }
+
+                void error(const std::string& msg) {
+                    op(OP_ERROR);
+                    str(msg);
+                }
+
+                bool finish(uint64_t source_hash) {
+                    flush();
+                    Header header{ ScriptCache::MAGIC, ScriptCache::VERSION, source_hash, size, hash };
+                    out.seekp(0);
+                    out.write(reinterpret_cast<const char*>(&header), sizeof header);
+                    out.close();
+                    return !out.fail();
+                }
+
+            private:
+                void visitExprStmt(ExprStmt* es) override {
+                    walkPostorder(es->getExpr(), this);
+                    op(OP_EXPR_STMT);
+                }
+
+                void visitPrintStmt(PrintStmt* ps) override {
+                    walkPostorder(ps->getExpr(), this);
+                    op(OP_PRINT);
+                }
+
+                void visitVariableStmt(VariableStmt* vs) override {
+                    if (vs->getExpr() != nullptr) {
+                        walkPostorder(vs->getExpr(), this);
+                        op(OP_VAR_INIT);
+                    } else {
+                        op(OP_VAR);
+                    }
+                    str(vs->getVariable());
+                }
+
+                void visitGraphStmt(GraphStmt* gs) override {
+                    walkPostorder(gs->getExpr(), this);
+                    op(OP_GRAPH);
+                }
+
+                void visitPGraphStmt(PGraphStmt* ps) override {
+                    walkPostorder(ps->getX(), this);
+                    walkPostorder(ps->getY(), this);
+                    walkPostorder(ps->getStart(), this);
+                    walkPostorder(ps->getEnd(), this);
+                    op(OP_PGRAPH);
+                }
+
+                void visitPolarStmt(PolarStmt* ps) override {
+                    walkPostorder(ps->getRadius(), this);
+                    walkPostorder(ps->getStart(), this);
+                    walkPostorder(ps->getEnd(), this);
+                    op(OP_POLAR);
+                }
+
+                void visitImplicitStmt(ImplicitStmt* is) override {
+                    walkPostorder(is->getExpr(), this);
+                    op(OP_IMPLICIT);
+                }
+
+                void visitPlotStmt(PlotStmt* ps) override {
+                    walkPostorder(ps->getFirstExpr(), this);
+                    walkPostorder(ps->getSecondExpr(), this);
+                    op(OP_PLOT);
+                }
+
+                void visitLineStmt(LineStmt* ls) override {
+                    walkPostorder(ls->getFirstExpr(), this);
+                    walkPostorder(ls->getSecondExpr(), this);
+                    walkPostorder(ls->getThirdExpr(), this);
+                    walkPostorder(ls->getFourthExpr(), this);
+                    op(OP_LINE);
+                }
+
+                void visitShowStmt(ShowStmt*) override { op(OP_SHOW); }
+                void visitHideStmt(HideStmt*) override { op(OP_HIDE); }
+                void visitClearStmt(ClearStmt*) override { op(OP_CLEAR); }
+                void visitCleanStmt(CleanStmt*) override { op(OP_CLEAN); }
+                void visitExitStmt(ExitStmt*) override { op(OP_EXIT); }
+
+                void visitPrecisionStmt(PrecisionStmt* ps) override {
+                    op(OP_PRECISION);
+                    op(static_cast<uint8_t>(ps->getPrecision()));
+                }
+
+                void visitTableStmt(TableStmt* ts) override {
+                    walkPostorder(ts->getExpr(), this);
+                    walkPostorder(ts->getStart(), this);
+                    walkPostorder(ts->getEnd(), this);
+                    walkPostorder(ts->getStep(), this);
+                    op(OP_TABLE);
+                    str(ts->getPath());
+                }
+
+                float visitLiteralExpr(LiteralExpr* expr) override {
+                    op(OP_LITERAL);
+                    pod(expr->getValue());
+                    pod(expr->getExact().hi);
+                    pod(expr->getExact().lo);
+                    return 0;
+                }
+
+                float visitUnaryExpr(UnaryExpr* expr) override {
+                    op(OP_UNARY);
+                    op(static_cast<uint8_t>(expr->getOperator().type));
+                    return 0;
+                }
+
+                float visitBinaryExpr(BinaryExpr* expr) override {
+                    op(OP_BINARY);
+                    op(static_cast<uint8_t>(expr->getOperator().type));
+                    return 0;
+                }
+
+                float visitIntegExpr(IntegExpr* expr) override {
+                    op(OP_INTEG);
+                    return 0;
+                }
+
+                float visitMultiIntegExpr(MultiIntegExpr* expr) override {
+                    op(OP_MULTI_INTEG);
+                    pod(static_cast<uint32_t>(expr->getVariables().size()));
+                    for (const std::string& name : expr->getVariables()) {
+                        str(name);
+                    }
+                    return 0;
+                }
+
+                float visitIdentifierExpr(IdentifierExpr* expr) override {
+                    op(OP_IDENTIFIER);
+                    str(expr->getVariable());
+                    return 0;
+                }
+
+                void op(uint8_t code) { buffer.push_back(static_cast<char>(code)); }
+
+                template <typename T>
+                void pod(const T& val) {
+                    const char* bytes = reinterpret_cast<const char*>(&val);
+                    buffer.insert(buffer.end(), bytes, bytes + sizeof val);
+                    if (buffer.size() >= 1 << 16) flush();
+                }
+
+                void str(const std::string& s) {
+                    pod(static_cast<uint32_t>(s.size()));
+                    buffer.insert(buffer.end(), s.begin(), s.end());
+                }
+
+                void flush() {
+                    hash = fnv1a(buffer.data(), buffer.size(), hash);
+                    size += buffer.size();
+                    out.write(buffer.data(), buffer.size());
+                    buffer.clear();
+                }
+
+            private:
+                std::ofstream out;
+                std::vector<char> buffer;
+                uint64_t size = 0;
+                uint64_t hash = fnv1a(nullptr, 0);
+        };
+
+        [[noreturn]] void corrupt() {
+            throw std::runtime_error("Error: corrupt script cache");
+        }
+    }
+
+    uint64_t fnv1a(const char* data, size_t size, uint64_t hash) {
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= static_cast<unsigned char>(data[i]);
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    uint64_t fnv1a(std::istream& in) {
+        std::vector<char> chunk(1 << 16);
+        uint64_t hash = fnv1a(nullptr, 0);
+        while (in.read(chunk.data(), chunk.size()) || in.gcount() > 0) {
+            hash = fnv1a(chunk.data(), static_cast<size_t>(in.gcount()), hash);
+        }
+        return hash;
+    }
+
+    bool MappedFile::open(const std::string& path) {
+        close();
+#ifdef _WIN32
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) return false;
+        fallback.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        begin = fallback.data();
+        length = fallback.size();
+        return true;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+
+        length = static_cast<size_t>(st.st_size);
+        if (length > 0) {
+            void* addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                ::close(fd);
+                length = 0;
+                return false;
+            }
+            madvise(addr, length, MADV_SEQUENTIAL);
+            begin = static_cast<const char*>(addr);
+        }
+        ::close(fd);
+        return true;
+#endif
+    }
+
+    void MappedFile::close() {
+#ifndef _WIN32
+        if (begin != nullptr && length > 0) {
+            munmap(const_cast<char*>(begin), length);
+        }
+#endif
+        fallback.clear();
+        begin = nullptr;
+        length = 0;
+    }
+
+    bool ScriptCache::build(std::istream& in, uint64_t hash, const std::string& path) {
+        std::string tmp = path + ".tmp";
+        {
+            CacheWriter writer(tmp);
+            if (!writer.good()) return false;
+
+            Lexer lexer(in);
+            Parser parser(lexer);
+
+            try {
+                std::unique_ptr<Stmt> stmt = nullptr;
+                while ((stmt = parser.parse()) != nullptr) {
+                    writer.write(stmt.get());
+                }
+            } catch (const std::runtime_error& e) {
+                writer.error(e.what());
+            } catch (const std::string& err) {
+                writer.error(err);
+            } catch (const char* err) {
+                writer.error(err);
+            }
+
+            if (!writer.finish(hash)) {
+                std::remove(tmp.c_str());
+                return false;
+            }
+        }
+        std::remove(path.c_str());
+        return std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+    bool ScriptCache::open(const std::string& path, uint64_t hash) {
+        operands.clear();
+        cur = end = nullptr;
+
+        if (!file.open(path) || file.size() < sizeof(Header)) return false;
+
+        Header header;
+        std::memcpy(&header, file.data(), sizeof header);
+
+        const char* payload = file.data() + sizeof header;
+        uint64_t size = file.size() - sizeof header;
+
+        if (header.magic != MAGIC || header.version != VERSION || header.source_hash != hash
+                || header.payload_size != size || header.payload_hash != fnv1a(payload, size)) {
+            file.close();
+            return false;
+        }
+
+        cur = payload;
+        end = payload + size;
+        return true;
+    }
+
+    std::unique_ptr<Stmt> ScriptCache::next() {
+        auto read = [this](void* dst, size_t n) {
+            if (static_cast<size_t>(end - cur) < n) corrupt();
+            std::memcpy(dst, cur, n);
+            cur += n;
+        };
+        auto readOp = [&read]() {
+            uint8_t code;
+            read(&code, 1);
+            return code;
+        };
+        auto readStr = [this, &read]() {
+            uint32_t len;
+            read(&len, sizeof len);
+            if (static_cast<size_t>(end - cur) < len) corrupt();
+            std::string s(cur, len);
+            cur += len;
+            return s;
+        };
+        auto pop = [this]() {
+            if (operands.empty()) corrupt();
+            auto expr = std::move(operands.back());
+            operands.pop_back();
+            return expr;
+        };
+        auto statement = [this](std::unique_ptr<Stmt> stmt) {
+            if (!operands.empty()) corrupt();
+            return stmt;
+        };
+
+        while (cur < end) {
+            switch (readOp()) {
+                case OP_LITERAL: {
+                    float val;
+                    DD exact;
+                    read(&val, sizeof val);
+                    read(&exact.hi, sizeof exact.hi);
+                    read(&exact.lo, sizeof exact.lo);
+                    operands.push_back(std::make_unique<LiteralExpr>(val, exact));
+                } break;
+                case OP_IDENTIFIER: {
+                    operands.push_back(std::make_unique<IdentifierExpr>(readStr()));
+                } break;
+                case OP_UNARY: {
+                    auto type = static_cast<TokenType>(readOp());
+                    auto expr = pop();
+                    operands.push_back(std::make_unique<UnaryExpr>(std::move(expr), Token(type, spelling(type))));
+                } break;
+                case OP_BINARY: {
+                    auto type = static_cast<TokenType>(readOp());
+                    auto right = pop();
+                    auto left = pop();
+                    operands.push_back(std::make_unique<BinaryExpr>(std::move(left), Token(type, spelling(type)), std::move(right)));
+                } break;
+                case OP_INTEG: {
+                    auto limit_end = pop();
+                    auto limit_start = pop();
+                    auto formula = pop();
+                    operands.push_back(std::make_unique<IntegExpr>(std::move(formula), std::move(limit_start), std::move(limit_end)));
+                } break;
+                case OP_MULTI_INTEG: {
+                    uint32_t count;
+                    read(&count, sizeof count);
+                    if (count == 0 || count > operands.size()) corrupt();
+                    std::vector<std::string> variables;
+                    for (uint32_t i = 0; i < count; ++i) {
+                        variables.push_back(readStr());
+                    }
+                    std::vector<std::unique_ptr<Expr>> limits(2 * count);
+                    for (size_t i = limits.size(); i-- > 0;) {
+                        limits[i] = pop();
+                    }
+                    auto formula = pop();
+                    operands.push_back(std::make_unique<MultiIntegExpr>(std::move(formula), std::move(variables), std::move(limits)));
+                } break;
+
+                case OP_EXPR_STMT: return statement(std::make_unique<ExprStmt>(pop()));
+                case OP_PRINT: return statement(std::make_unique<PrintStmt>(pop()));
+                case OP_VAR: return statement(std::make_unique<VariableStmt>(readStr(), nullptr));
+                case OP_VAR_INIT: {
+                    auto expr = pop();
+                    return statement(std::make_unique<VariableStmt>(readStr(), std::move(expr)));
+                }
+                case OP_GRAPH: return statement(std::make_unique<GraphStmt>(pop()));
+                case OP_PGRAPH: {
+                    auto end = pop();
+                    auto start = pop();
+                    auto fy = pop();
+                    auto fx = pop();
+                    return statement(std::make_unique<PGraphStmt>(std::move(fx), std::move(fy), std::move(start), std::move(end)));
+                }
+                case OP_POLAR: {
+                    auto end = pop();
+                    auto start = pop();
+                    auto r = pop();
+                    return statement(std::make_unique<PolarStmt>(std::move(r), std::move(start), std::move(end)));
+                }
+                case OP_IMPLICIT: return statement(std::make_unique<ImplicitStmt>(pop()));
+                case OP_PLOT: {
+                    auto b = pop();
+                    auto a = pop();
+                    return statement(std::make_unique<PlotStmt>(std::move(a), std::move(b)));
+                }
+                case OP_LINE: {
+                    auto d = pop();
+                    auto c = pop();
+                    auto b = pop();
+                    auto a = pop();
+                    return statement(std::make_unique<LineStmt>(std::move(a), std::move(b), std::move(c), std::move(d)));
+                }
+                case OP_SHOW: return statement(std::make_unique<ShowStmt>());
+                case OP_HIDE: return statement(std::make_unique<HideStmt>());
+                case OP_CLEAR: return statement(std::make_unique<ClearStmt>());
+                case OP_CLEAN: return statement(std::make_unique<CleanStmt>());
+                case OP_EXIT: return statement(std::make_unique<ExitStmt>());
+                case OP_PRECISION: {
+                    uint8_t precision = readOp();
+                    if (precision > static_cast<uint8_t>(Precision::DOUBLE_DOUBLE)) corrupt();
+                    return statement(std::make_unique<PrecisionStmt>(static_cast<Precision>(precision)));
+                }
+                case OP_TABLE: {
+                    auto step = pop();
+                    auto end = pop();
+                    auto start = pop();
+                    auto expr = pop();
+                    return statement(std::make_unique<TableStmt>(std::move(expr), std::move(start), std::move(end), std::move(step), readStr()));
+                }
+                case OP_ERROR: {
+                    std::string err = readStr();
+                    cur = end;
+                    throw err;
+                }
+                default: corrupt();
+            }
+        }
+
+        if (!operands.empty()) corrupt();
+        return nullptr;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../parser/expr.h"
+
+namespace Acalc {
+
+    uint64_t fnv1a(const char* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull);
+
+    inline uint64_t fnv1a(const std::string& data) {
+        return fnv1a(data.data(), data.size());
+    }
+
+    // Hashes the rest of `in` in fixed-size chunks.
+    uint64_t fnv1a(std::istream& in);
+
+    // Read-only view of a whole file, memory-mapped where the platform allows.
+    class MappedFile {
+        public:
+            MappedFile() = default;
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+            ~MappedFile() { close(); }
+
+            bool open(const std::string& path);
+            void close();
+
+            const char* data() const { return begin; }
+            size_t size() const { return length; }
+
+        private:
+            const char* begin = nullptr;
+            size_t length = 0;
+            std::vector<char> fallback;
+    };
+
+    // Precompiled form of a script, stored next to it as "<script>.acc".
+    //
+    // Layout (native byte order):
+    //   u32 magic, u32 version, u64 source hash, u64 payload size, u64 payload hash
+    //   payload: one record per statement. Expressions are written in
+    //   post-order, so a record is its operand nodes followed by the
+    //   statement opcode that consumes them.
+    //
+    // A parse error is recorded in place of the statement that failed, so
+    // replaying a cache behaves exactly like re-running the script.
+    class ScriptCache {
+        public:
+            static constexpr uint32_t MAGIC = 0x31434341; // "ACC1"
+            static constexpr uint32_t VERSION = 7;
+
+            static std::string pathFor(const std::string& script) { return script + ".acc"; }
+
+            // Lexes and parses `in` and writes its cache to `path` one
+            // statement at a time. The file is written under a temporary
+            // name and renamed into place, so a crash never leaves a
+            // truncated cache behind.
+            static bool build(std::istream& in, uint64_t hash, const std::string& path);
+
+            // Maps `path` and checks it belongs to a script with `hash`.
+            // Returns false when the cache is missing, stale or corrupt.
+            bool open(const std::string& path, uint64_t hash);
+
+            // Decodes the next statement, or returns nullptr at the end.
+            std::unique_ptr<Stmt> next();
+
+        private:
+            MappedFile file;
+            const char* cur = nullptr;
+            const char* end = nullptr;
+            std::vector<std::unique_ptr<Expr>> operands;
+    };
+}
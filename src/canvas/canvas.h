@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace Acalc {
+
+    struct Point {
+        float x;
+        float y;
+    };
+
+    // Everything the interpreter draws goes through a Canvas, so the
+    // language core does not depend on SDL or the graph engine.
+    class Canvas {
+        public:
+            virtual ~Canvas() = default;
+
+            virtual void plot(float x, float y) = 0;
+            virtual void line(float x1, float y1, float x2, float y2) = 0;
+            virtual void show() = 0;
+            virtual void hide() = 0;
+            virtual void clean() = 0;
+            virtual void exit() = 0;
+
+            // Draws curve `id`, replacing whatever was drawn under that id
+            // before. A canvas that keeps nothing cannot take the old curve
+            // away, so by default the points are simply plotted.
+            virtual void curve(size_t, std::vector<Point> points) {
+                for (const Point& p : points) {
+                    plot(p.x, p.y);
+                }
+            }
+
+            // Joins consecutive points with lines.
+            virtual void polyline(std::vector<Point> points) {
+                if (points.size() == 1) {
+                    plot(points[0].x, points[0].y);
+                }
+                for (size_t i = 1; i < points.size(); ++i) {
+                    line(points[i - 1].x, points[i - 1].y, points[i].x, points[i].y);
+                }
+            }
+
+            // Whether the canvas keeps what it was given, so that `clean`
+            // plus a replay of everything is never needed to change a curve.
+            virtual bool retained() const { return false; }
+    };
+}
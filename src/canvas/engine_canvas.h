@@ -0,0 +1,17 @@
+#pragma once
+
+#include "canvas.h"
+#include "../graph/engine.h"
+
+namespace Acalc {
+
+    class EngineCanvas : public Canvas {
+        public:
+            void plot(float x, float y) override { Graph::Engine::plot(x, y); }
+            void line(float x1, float y1, float x2, float y2) override { Graph::Engine::line(x1, y1, x2, y2); }
+            void show() override { Graph::Engine::show(); }
+            void hide() override { Graph::Engine::hide(); }
+            void clean() override { Graph::Engine::clean(); }
+            void exit() override { Graph::Engine::exit(); }
+    };
+}
@@ -0,0 +1,153 @@
+#include "scene.h"
+
+namespace Acalc {
+
+    Scene::Scene(Canvas& target) : target{target} {
+        presenter = std::thread([this]() { present(); });
+    }
+
+    Scene::~Scene() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        presenter.join();
+    }
+
+    void Scene::plot(float x, float y) {
+        std::lock_guard<std::mutex> lock(mutex);
+        points.items.push_back({ x, y });
+        changed();
+    }
+
+    void Scene::line(float x1, float y1, float x2, float y2) {
+        std::lock_guard<std::mutex> lock(mutex);
+        lines.items.push_back({ { x1, y1 }, { x2, y2 } });
+        changed();
+    }
+
+    void Scene::polyline(std::vector<Point> points) {
+        std::lock_guard<std::mutex> lock(mutex);
+        paths.items.push_back(std::move(points));
+        changed();
+    }
+
+    void Scene::show() {
+        target.show();
+    }
+
+    void Scene::hide() {
+        target.hide();
+    }
+
+    void Scene::clean() {
+        std::lock_guard<std::mutex> lock(mutex);
+        points = {};
+        lines = {};
+        paths = {};
+        curves.clear();
+        repaint = true;
+        changed();
+    }
+
+    void Scene::exit() {
+        sync();
+        target.exit();
+    }
+
+    void Scene::curve(size_t id, std::vector<Point> points) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Curve& curve = curves[id];
+        if (curve.presented) {
+            repaint = true;
+        }
+        curve.points = std::move(points);
+        curve.presented = false;
+        changed();
+    }
+
+    void Scene::sync() {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this]() { return !dirty && !busy; });
+    }
+
+    size_t Scene::repaints() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return repaintCount;
+    }
+
+    // Called with the lock held.
+    void Scene::changed() {
+        dirty = true;
+        wake.notify_one();
+    }
+
+    // Takes a copy of whatever the target has not seen yet while holding
+    // the lock, and draws it without the lock so the interpreter is never
+    // held up by the target.
+    void Scene::present() {
+        std::vector<Point> newPoints;
+        std::vector<Segment> newLines;
+        std::vector<std::vector<Point>> newPaths;
+        std::vector<Point> newCurves;
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (true) {
+            wake.wait(lock, [this]() { return dirty || stopping; });
+            if (!dirty) break;
+
+            dirty = false;
+            busy = true;
+
+            bool full = repaint;
+            repaint = false;
+            if (full) {
+                points.presented = 0;
+                lines.presented = 0;
+                paths.presented = 0;
+                for (auto& [id, curve] : curves) {
+                    curve.presented = false;
+                }
+                ++repaintCount;
+            }
+
+            newPoints.assign(points.items.begin() + points.presented, points.items.end());
+            points.presented = points.items.size();
+            newLines.assign(lines.items.begin() + lines.presented, lines.items.end());
+            lines.presented = lines.items.size();
+            newPaths.assign(paths.items.begin() + paths.presented, paths.items.end());
+            paths.presented = paths.items.size();
+            newCurves.clear();
+            for (auto& [id, curve] : curves) {
+                if (!curve.presented) {
+                    newCurves.insert(newCurves.end(), curve.points.begin(), curve.points.end());
+                    curve.presented = true;
+                }
+            }
+
+            lock.unlock();
+
+            if (full) {
+                target.clean();
+            }
+            for (const Point& p : newCurves) {
+                target.plot(p.x, p.y);
+            }
+            for (const Segment& s : newLines) {
+                target.line(s.from.x, s.from.y, s.to.x, s.to.y);
+            }
+            for (std::vector<Point>& path : newPaths) {
+                target.polyline(std::move(path));
+            }
+            for (const Point& p : newPoints) {
+                target.plot(p.x, p.y);
+            }
+
+            lock.lock();
+            busy = false;
+            idle.notify_all();
+        }
+    }
+}
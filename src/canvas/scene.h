@@ -0,0 +1,83 @@
+#pragma once
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "canvas.h"
+
+namespace Acalc {
+
+    // A retained picture in front of another canvas. Points, lines,
+    // polylines and curves are kept in separate layers, and each layer remembers how much
+    // of it the target has already been given. A presenter thread sleeps
+    // until something changes, then forwards only the new points, lines
+    // and curves. Replacing a curve that was already drawn, or `clean`,
+    // needs a full repaint, because the target can only erase everything.
+    // Axes and the render loop belong to the graph engine, not to the scene.
+    class Scene : public Canvas {
+        public:
+            Scene(Canvas& target);
+            Scene(const Scene&) = delete;
+            Scene& operator=(const Scene&) = delete;
+            ~Scene();
+
+            void plot(float x, float y) override;
+            void line(float x1, float y1, float x2, float y2) override;
+            void show() override;
+            void hide() override;
+            void clean() override;
+            void exit() override;
+
+            void polyline(std::vector<Point> points) override;
+            void curve(size_t id, std::vector<Point> points) override;
+            bool retained() const override { return true; }
+
+            // Blocks until everything drawn so far has reached the target.
+            void sync();
+
+            // Number of full repaints sent to the target.
+            size_t repaints() const;
+
+        private:
+            struct Segment {
+                Point from;
+                Point to;
+            };
+
+            template <typename T>
+            struct Layer {
+                std::vector<T> items;
+                size_t presented = 0;
+            };
+
+            struct Curve {
+                std::vector<Point> points;
+                bool presented = false;
+            };
+
+            void present();
+            void changed();
+
+        private:
+            Canvas& target;
+
+            mutable std::mutex mutex;
+            std::condition_variable wake;
+            std::condition_variable idle;
+
+            Layer<Point> points;
+            Layer<Segment> lines;
+            Layer<std::vector<Point>> paths;
+            std::map<size_t, Curve> curves;
+
+            bool dirty = false;
+            bool repaint = false;
+            bool busy = false;
+            bool stopping = false;
+            size_t repaintCount = 0;
+
+            std::thread presenter;
+    };
+}
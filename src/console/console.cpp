@@ -0,0 +1,173 @@
+#include "console.h"
+#include <algorithm>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <sstream>
+#include <thread>
+
+namespace Acalc {
+
+    namespace {
+        // The console that SIGINT is delivered to.
+        std::atomic<Console*> active{ nullptr };
+    }
+
+    void Console::StatusLine::show(const std::string& text) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (text.empty()) {
+            erase();
+        } else {
+            // Written over the previous text, padded to cover all of it.
+            target->sputc('\r');
+            target->sputn(text.data(), static_cast<std::streamsize>(text.size()));
+            for (size_t i = text.size(); i < shown; ++i) {
+                target->sputc(' ');
+            }
+            shown = std::max(shown, text.size());
+        }
+        target->pubsync();
+    }
+
+    // Overwrites the line with spaces rather than an escape sequence, so it
+    // works in any terminal.
+    void Console::StatusLine::erase() {
+        if (shown == 0) return;
+        target->sputc('\r');
+        for (size_t i = 0; i < shown; ++i) {
+            target->sputc(' ');
+        }
+        target->sputc('\r');
+        shown = 0;
+    }
+
+    int Console::StatusLine::overflow(int c) {
+        if (c == traits_type::eof()) return traits_type::not_eof(c);
+        std::lock_guard<std::mutex> lock(mutex);
+        erase();
+        return target->sputc(static_cast<char>(c));
+    }
+
+    std::streamsize Console::StatusLine::xsputn(const char* s, std::streamsize n) {
+        std::lock_guard<std::mutex> lock(mutex);
+        erase();
+        return target->sputn(s, n);
+    }
+
+    int Console::StatusLine::sync() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return target->pubsync();
+    }
+
+    void Console::interrupt(int signal) {
+        // Some platforms reset the handler before calling it.
+        std::signal(SIGINT, interrupt);
+
+        Console* console = active.load();
+        if (console != nullptr && console->busy) {
+            console->session.cancel();
+            console->interrupted = true;
+        } else {
+            std::signal(SIGINT, SIG_DFL);
+            std::raise(signal);
+        }
+    }
+
+    // getline cannot be interrupted portably, so the reader is detached and
+    // holds its own references to the stream and the queue.
+    void Console::read() {
+        if (input != nullptr) return;
+
+        input = std::make_shared<Input>();
+        std::thread([input = input, source = in]() {
+            std::string line;
+            while (std::getline(*source, line)) {
+                std::lock_guard<std::mutex> lock(input->mutex);
+                input->lines.push_back(std::move(line));
+                input->ready.notify_one();
+            }
+            std::lock_guard<std::mutex> lock(input->mutex);
+            input->ended = true;
+            input->ready.notify_one();
+        }).detach();
+    }
+
+    void Console::tick(StatusLine& status) {
+        std::unique_lock<std::mutex> lock(tickMutex);
+        while (ticking) {
+            tickReady.wait_for(lock, PERIOD);
+            if (!ticking || !busy) continue;
+
+            auto elapsed = std::chrono::steady_clock::now() - started;
+            if (elapsed < DELAY) continue;
+
+            std::ostringstream text;
+            float done = session.progress();
+            if (done >= 0) {
+                text << "[" << static_cast<int>(std::floor(done * 100)) << "%] ";
+            }
+            text.precision(1);
+            text << std::fixed << std::chrono::duration<float>(elapsed).count() << "s, Ctrl-C to cancel";
+            status.show(text.str());
+        }
+    }
+
+    void Console::run() {
+        StatusLine status(out.rdbuf());
+        std::streambuf* previous = out.rdbuf(&status);
+
+        read();
+
+        ticking = true;
+        std::thread ticker([this, &status]() { tick(status); });
+
+        active = this;
+        std::signal(SIGINT, interrupt);
+
+        while (!session.exited()) {
+            std::string line;
+            {
+                std::unique_lock<std::mutex> lock(input->mutex);
+                if (input->lines.empty() && !input->ended) {
+                    out << ">> " << std::flush;
+                }
+                input->ready.wait(lock, [this]() { return !input->lines.empty() || input->ended; });
+                if (input->lines.empty()) break;
+                line = std::move(input->lines.front());
+                input->lines.pop_front();
+            }
+
+            // A Ctrl-C once busy is raised cancels this line, so the session
+            // forgets earlier cancels before that rather than on entry.
+            session.prepare();
+            {
+                std::lock_guard<std::mutex> lock(tickMutex);
+                started = std::chrono::steady_clock::now();
+                busy = true;
+            }
+            session.runPrepared(line);
+            {
+                std::lock_guard<std::mutex> lock(tickMutex);
+                busy = false;
+                status.show("");
+            }
+
+            if (interrupted.exchange(false)) {
+                std::lock_guard<std::mutex> lock(input->mutex);
+                input->lines.clear();
+            }
+        }
+
+        std::signal(SIGINT, SIG_DFL);
+        active = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(tickMutex);
+            ticking = false;
+        }
+        tickReady.notify_one();
+        ticker.join();
+
+        out.rdbuf(previous);
+    }
+}
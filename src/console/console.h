@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include "../session/session.h"
+
+namespace Acalc {
+
+    // The interactive prompt. Lines are read on their own thread, so the
+    // user can type ahead while a statement runs, and are run in order.
+    // A statement still running after DELAY shows a progress line, which
+    // output written meanwhile erases first. Ctrl-C cancels the running
+    // statement together with anything typed ahead and keeps the session's
+    // variables; at an idle prompt it quits as before.
+    class Console {
+        public:
+            static constexpr std::chrono::milliseconds DELAY{ 500 };
+            static constexpr std::chrono::milliseconds PERIOD{ 100 };
+
+            // `out` must be the stream the session prints to. Lines come
+            // from `in`, which the reader thread keeps alive as long as it
+            // needs it, even past the console.
+            Console(Session& session, std::shared_ptr<std::istream> in, std::ostream& out = std::cout)
+            : session{session}, in{std::move(in)}, out{out} {}
+
+            // Reads std::cin.
+            explicit Console(Session& session, std::ostream& out = std::cout)
+            : Console(session, std::shared_ptr<std::istream>(&std::cin, [](std::istream*) {}), out) {}
+
+            Console(const Console&) = delete;
+            Console& operator=(const Console&) = delete;
+
+            // Returns when the input ends or the session exits.
+            void run();
+
+        private:
+            // Forwards to `target`, first erasing the progress line if one
+            // is showing.
+            class StatusLine : public std::streambuf {
+                public:
+                    explicit StatusLine(std::streambuf* target) : target{target} {}
+
+                    // Replaces the progress line; an empty text removes it.
+                    void show(const std::string& text);
+
+                protected:
+                    int overflow(int c) override;
+                    std::streamsize xsputn(const char* s, std::streamsize n) override;
+                    int sync() override;
+
+                private:
+                    void erase();
+
+                private:
+                    std::streambuf* target;
+                    std::mutex mutex;
+                    size_t shown = 0;
+            };
+
+            // Shared with the reader thread. It is started by the first run()
+            // and reads until the stream ends, so it may outlive run() and
+            // the console while it waits for a line that never comes; later
+            // runs take up the lines it queues meanwhile.
+            struct Input {
+                std::mutex mutex;
+                std::condition_variable ready;
+                std::deque<std::string> lines;
+                bool ended = false;
+            };
+
+            static void interrupt(int);
+            void read();
+            void tick(StatusLine& status);
+
+        private:
+            Session& session;
+            std::shared_ptr<std::istream> in;
+            std::ostream& out;
+            std::shared_ptr<Input> input;
+
+            std::atomic<bool> busy{ false };
+            std::atomic<bool> interrupted{ false };
+
+            std::mutex tickMutex;
+            std::condition_variable tickReady;
+            std::chrono::steady_clock::time_point started;
+            bool ticking = false;
+    };
+}
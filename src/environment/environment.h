@@ -3,31 +3,75 @@
 #include <map>
 #include <string>
 #include <cmath>
+#include <cstdint>
 #include <stdexcept>
+#include "../numeric/double_double.h"
 
 class Environment {
     public:
+        // A variable's storage. `version` changes on every write so cached
+        // results can tell whether the variables they read have changed.
+        // `exact` is the value in double-double precision, which `value`
+        // rounds; a plain float write keeps it equal to `value`.
+        struct Slot {
+            float value;
+            uint64_t version;
+            Acalc::DD exact;
+
+            void set(float val) {
+                value = val;
+                exact = Acalc::DD(val);
+                ++version;
+            }
+
+            void set(const Acalc::DD& val) {
+                value = static_cast<float>(val.hi);
+                exact = val;
+                ++version;
+            }
+        };
+
         Environment() {
-            saved["pi"] = 3.1415926535897932385;
-            saved["e"] = 2.7182818284590452354;
-            saved["phi"] = 1.6180339887498948482;
-            saved["tau"] = 6.2831853071795864769;
-            saved["x"] = 0;
+            saved["pi"] = { 3.1415926535897932385f, 0, Acalc::DD_PI };
+            saved["e"] = { 2.7182818284590452354f, 0, Acalc::DD_E };
+            saved["phi"] = { 1.6180339887498948482f, 0, Acalc::DD_PHI };
+            saved["tau"] = { 6.2831853071795864769f, 0, Acalc::DD_PI * 2.0 };
+            saved["x"] = { 0, 0 };
+            saved["y"] = { 0, 0 };
+            saved["t"] = { 0, 0 };
+            saved["err"] = { 0, 0 };
+        }
+
+        template <typename T>
+        void define(const std::string& s, const T& val) {
+            bind(s).set(val);
         }
 
-        void define(const std::string& s, float val) {
+        // The slot of a variable that is about to be written, declared at 0
+        // if it is new.
+        Slot& bind(const std::string& s) {
             if (s == "pi" || s == "e" || s == "phi" || s == "tau") {
                 throw std::runtime_error(s + " is a constant. " + "Cannot redefine constant");
             }
-            saved[s] = val;
+            return saved[s];
+        }
+
+        Slot* find(const std::string& s) {
+            auto it = saved.find(s);
+            return it == saved.end() ? nullptr : &it->second;
         }
 
         float& get(const std::string& s) {
-            if (saved.find(s) == saved.end())
+            return slot(s).value;
+        }
+
+        Slot& slot(const std::string& s) {
+            auto it = saved.find(s);
+            if (it == saved.end())
                 throw s + " not declared";
-            return saved[s];
+            return it->second;
         }
 
     private:
-        std::map<std::string, float> saved;
+        std::map<std::string, Slot> saved;
 };
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "program.h"
+#include "../canvas/canvas.h"
+
+namespace Acalc {
+
+    // The curves on screen, kept as live bindings from a compiled formula
+    // to its points on screen. A dependency index maps each variable to the curves
+    // that read it, along with the variable's version when they were last
+    // sampled. Any write to a variable bumps its version, whether it comes
+    // from var, integ or table, so comparing versions marks exactly the
+    // curves to resample; the others are redrawn from the points they
+    // already have.
+    class Bindings {
+        public:
+            struct Curve {
+                Program program;
+                std::vector<Point> points;
+                bool dirty = false;
+            };
+
+            // Retains `program` as a curve and returns its index. An
+            // identical formula that is already bound is reused.
+            size_t bind(Program program, const Environment::Slot* bound) {
+                uint64_t shape = program.shape();
+                for (size_t i = 0; i < curves.size(); ++i) {
+                    if (curves[i].program.shape() == shape) return i;
+                }
+
+                size_t index = curves.size();
+                for (const Environment::Slot* slot : program.reads()) {
+                    if (slot == bound) continue;
+                    Dependency& dependency = dependents[slot];
+                    if (dependency.users.empty()) {
+                        dependency.version = slot->version;
+                    }
+                    if (dependency.users.empty() || dependency.users.back() != index) {
+                        dependency.users.push_back(index);
+                    }
+                }
+                curves.push_back({ std::move(program), {}, false });
+                return index;
+            }
+
+            // Marks every curve reading a variable written since the last
+            // sweep or settle for resampling. Returns whether any curve was
+            // affected.
+            bool sweep() {
+                bool changed = false;
+                for (auto& [slot, dependency] : dependents) {
+                    if (slot->version == dependency.version) continue;
+                    dependency.version = slot->version;
+                    for (size_t index : dependency.users) {
+                        curves[index].dirty = true;
+                    }
+                    changed = true;
+                }
+                pending = pending || changed;
+                return changed;
+            }
+
+            bool dirty() const { return pending; }
+
+            // Called once the dirty curves are resampled. Variables written
+            // while sampling, such as those an integ binds, do not count as
+            // changes.
+            void settle() {
+                for (auto& [slot, dependency] : dependents) {
+                    dependency.version = slot->version;
+                }
+                pending = false;
+            }
+
+            std::vector<Curve>& all() { return curves; }
+
+            void clear() {
+                curves.clear();
+                dependents.clear();
+                pending = false;
+            }
+
+        private:
+            struct Dependency {
+                std::vector<size_t> users;
+                uint64_t version = 0;
+            };
+
+            std::vector<Curve> curves;
+            std::unordered_map<const Environment::Slot*, Dependency> dependents;
+            bool pending = false;
+    };
+}
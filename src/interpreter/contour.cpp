@@ -0,0 +1,191 @@
+#include "contour.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include "workers.h"
+
+namespace Acalc {
+
+    namespace {
+
+        constexpr int WIDTH = Contour::WIDTH;
+        constexpr int HEIGHT = Contour::HEIGHT;
+
+        // Edges crossed by the curve for each marching squares case, as
+        // pairs of edge numbers ending in -1. Corner k is bit k of the case
+        // (clockwise from the top left) and edge k joins corner k to corner
+        // k + 1. Cases 5 and 10 are saddles and are decided by the centre.
+        constexpr int8_t EDGES[16][5] = {
+            { -1 }, { 3, 0, -1 }, { 0, 1, -1 }, { 3, 1, -1 },
+            { 1, 2, -1 }, { -1 }, { 0, 2, -1 }, { 3, 2, -1 },
+            { 2, 3, -1 }, { 0, 2, -1 }, { -1 }, { 1, 2, -1 },
+            { 1, 3, -1 }, { 0, 1, -1 }, { 0, 3, -1 }, { -1 },
+        };
+        constexpr int8_t APART[5] = { 3, 0, 1, 2, -1 };
+        constexpr int8_t JOINED[5] = { 0, 1, 2, 3, -1 };
+
+        struct Cell {
+            int x0;
+            int y0;
+            int size;
+        };
+
+        // The quadtree walk for one tile, with its own scratch space so
+        // that workers share nothing but the program.
+        class Tracer {
+            public:
+                Tracer(const Program& f, Environment::Slot* x, Environment::Slot* y) : f{f}, x{x}, y{y} {}
+
+                void tile(int x0, int y0, std::vector<Point>& out) {
+                    cells.push_back({ x0, y0, Contour::TILE });
+
+                    while (!cells.empty()) {
+                        Cell c = cells.back();
+                        cells.pop_back();
+
+                        int x1 = std::min(c.x0 + c.size, WIDTH);
+                        int y1 = std::min(c.y0 + c.size, HEIGHT);
+
+                        Program::Range ranges[] = {
+                            { x, { static_cast<float>(c.x0 - 400), static_cast<float>(x1 - 400) } },
+                            { y, { static_cast<float>(300 - y1), static_cast<float>(300 - c.y0) } },
+                        };
+                        Program::Interval v = f.bounds(ranges, 2, intervals);
+                        if (v.lo > 0 || v.hi < 0) continue;
+
+                        if (c.size > Contour::LEAF) {
+                            int half = c.size / 2;
+                            for (int k = 0; k < 4; ++k) {
+                                Cell child{ c.x0 + (k & 1) * half, c.y0 + (k >> 1) * half, half };
+                                if (child.x0 < WIDTH && child.y0 < HEIGHT) {
+                                    cells.push_back(child);
+                                }
+                            }
+                            continue;
+                        }
+
+                        march(c.x0, c.y0, x1, y1, out);
+                    }
+                }
+
+            private:
+                void march(int x0, int y0, int x1, int y1, std::vector<Point>& out) {
+                    int nx = x1 - x0 + 1;
+                    int ny = y1 - y0 + 1;
+
+                    xs.clear();
+                    ys.clear();
+                    for (int j = 0; j < ny; ++j) {
+                        for (int i = 0; i < nx; ++i) {
+                            xs.push_back(static_cast<float>(x0 + i - 400));
+                            ys.push_back(static_cast<float>(300 - (y0 + j)));
+                        }
+                    }
+                    values.resize(xs.size());
+                    Program::Lane lanes[] = { { x, xs.data() }, { y, ys.data() } };
+                    f.runBatch(lanes, 2, values.data(), values.size(), stack, Program::Faults::QUIET);
+
+                    for (int j = 0; j + 1 < ny; ++j) {
+                        for (int i = 0; i + 1 < nx; ++i) {
+                            float v[4] = {
+                                values[j * nx + i], values[j * nx + i + 1],
+                                values[(j + 1) * nx + i + 1], values[(j + 1) * nx + i],
+                            };
+                            // A corner where f is undefined or infinite, such
+                            // as on a pole the pixel grid lands on, is a
+                            // missing sample; contouring across it would
+                            // join the two sides of the pole.
+                            if (!std::isfinite(v[0]) || !std::isfinite(v[1]) || !std::isfinite(v[2]) || !std::isfinite(v[3])) continue;
+
+                            int index = (v[0] > 0) | (v[1] > 0) << 1 | (v[2] > 0) << 2 | (v[3] > 0) << 3;
+                            const int8_t* edges = EDGES[index];
+                            if (index == 5 || index == 10) {
+                                bool centre = (v[0] + v[1] + v[2] + v[3]) > 0;
+                                edges = (index == 5) == centre ? JOINED : APART;
+                            }
+
+                            float px[4] = { float(x0 + i), float(x0 + i + 1), float(x0 + i + 1), float(x0 + i) };
+                            float py[4] = { float(y0 + j), float(y0 + j), float(y0 + j + 1), float(y0 + j + 1) };
+                            for (; *edges != -1; ++edges) {
+                                int a = *edges;
+                                int b = (a + 1) % 4;
+                                float t = v[a] / (v[a] - v[b]);
+                                if (!std::isfinite(t)) t = 0.5f;
+                                out.push_back({ px[a] + t * (px[b] - px[a]), py[a] + t * (py[b] - py[a]) });
+                            }
+                        }
+                    }
+                }
+
+            private:
+                const Program& f;
+                Environment::Slot* x;
+                Environment::Slot* y;
+                std::vector<Cell> cells;
+                std::vector<Program::Interval> intervals;
+                std::vector<float> xs;
+                std::vector<float> ys;
+                std::vector<float> values;
+                std::vector<float> stack;
+        };
+    }
+
+    void Contour::trace(const Program& f, Environment::Slot* x, Environment::Slot* y, std::vector<Point>& out,
+                        Progress* progress, size_t workers) {
+        std::vector<Cell> tiles;
+        for (int y0 = 0; y0 < HEIGHT; y0 += TILE) {
+            for (int x0 = 0; x0 < WIDTH; x0 += TILE) {
+                tiles.push_back({ x0, y0, TILE });
+            }
+        }
+
+        // Each tile's segments are kept apart and joined in tile order, so
+        // the output does not depend on scheduling.
+        std::vector<std::vector<Point>> results(tiles.size());
+        std::atomic<size_t> next{ 0 };
+        std::atomic<bool> failed{ false };
+        std::exception_ptr error;
+        std::mutex errorMutex;
+        bool reporting = progress != nullptr && progress->claim(tiles.size());
+
+        auto work = [&]() {
+            Tracer tracer(f, x, y);
+            size_t i;
+            while (!failed && (i = next++) < tiles.size()) {
+                try {
+                    if (progress != nullptr) progress->check();
+                    tracer.tile(tiles[i].x0, tiles[i].y0, results[i]);
+                    if (reporting) progress->advance(1);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error) error = std::current_exception();
+                    failed = true;
+                }
+            }
+        };
+
+        size_t count = f.pure() ? resolveWorkers(workers) : 1;
+        count = std::min(count, tiles.size());
+
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < count; ++i) {
+            threads.emplace_back(work);
+        }
+        work();
+        for (std::thread& worker : threads) {
+            worker.join();
+        }
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+
+        for (const std::vector<Point>& segments : results) {
+            out.insert(out.end(), segments.begin(), segments.end());
+        }
+    }
+}
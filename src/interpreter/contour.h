@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+#include "program.h"
+#include "../canvas/canvas.h"
+
+namespace Acalc {
+
+    // Traces the zero set of f(x, y) across the window. The window is cut
+    // into TILE-pixel tiles, which are spread over worker threads. Each tile
+    // is a quadtree: a cell whose interval bounds exclude 0 holds no part of
+    // the curve and is dropped, and any other cell is split until it is LEAF
+    // pixels wide. A leaf is sampled on a one-pixel grid in a single batch
+    // and contoured with marching squares. Samples where f is undefined or
+    // infinite leave a gap in the curve rather than failing the trace.
+    class Contour {
+        public:
+            static constexpr int WIDTH = 800;
+            static constexpr int HEIGHT = 600;
+            static constexpr int TILE = 64;
+            static constexpr int LEAF = 8;
+
+            // Appends the curve to `out` as pairs of segment end points, in
+            // window coordinates. Tiles are spread over `workers` threads, 0
+            // for one per core, but programs containing integ are traced on
+            // the calling thread only. `progress` is polled before every
+            // tile.
+            static void trace(const Program& f, Environment::Slot* x, Environment::Slot* y, std::vector<Point>& out,
+                              Progress* progress = nullptr, size_t workers = 0);
+    };
+}
@@ -0,0 +1,499 @@
+#include "cubature.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+namespace Acalc {
+
+    namespace {
+
+        // Points in one batch handed to a thread.
+        constexpr size_t CHUNK = 1024;
+        // Most regions split per round of the adaptive search.
+        constexpr size_t ROUND = 256;
+        // Points per replicate in the first quasi-Monte Carlo round.
+        constexpr size_t FIRST = 1024;
+
+        using Integrand = Cubature::Integrand;
+        using Result = Cubature::Result;
+
+        // A thread's scratch space.
+        struct Scratch {
+            std::vector<float> coords;
+            std::vector<float> values;
+            std::vector<float> stack;
+            const float* points[Cubature::MAX_DIMENSIONS];
+        };
+
+        // Polls a Progress, and reports to it if the integral claimed it.
+        struct Tracker {
+            Progress* progress;
+            bool reporting;
+
+            void check() const {
+                if (progress != nullptr) progress->check();
+            }
+
+            void advance(size_t units) const {
+                if (reporting) progress->advance(units);
+            }
+        };
+
+        bool converged(double value, double error) {
+            if (!std::isfinite(value)) return true;
+            return error <= std::max(Cubature::ABSOLUTE, Cubature::RELATIVE * std::abs(value));
+        }
+
+        // Calls task(i, scratch) for every i below `count`, on the calling
+        // thread and up to `workers` - 1 more. The first exception stops
+        // the remaining tasks and is rethrown.
+        template <typename Task>
+        void forEach(size_t count, size_t workers, const Task& task) {
+            std::atomic<size_t> next{ 0 };
+            std::atomic<bool> failed{ false };
+            std::exception_ptr error;
+            std::mutex errorMutex;
+
+            auto work = [&]() {
+                Scratch scratch;
+                size_t i;
+                while (!failed && (i = next++) < count) {
+                    try {
+                        task(i, scratch);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(errorMutex);
+                        if (!error) error = std::current_exception();
+                        failed = true;
+                    }
+                }
+            };
+
+            size_t spawn = std::min(std::max<size_t>(workers, 1), count);
+
+            std::vector<std::thread> threads;
+            for (size_t i = 1; i < spawn; ++i) {
+                threads.emplace_back(work);
+            }
+            work();
+            for (std::thread& worker : threads) {
+                worker.join();
+            }
+
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+        // A rule on [-1, 1]^dims and the lower degree rule embedded in it,
+        // with weights that sum to 1.
+        struct Rule {
+            size_t dims;
+            std::vector<double> offsets;
+            std::vector<double> high;
+            std::vector<double> low;
+
+            size_t size() const { return high.size(); }
+
+            void add(const double* offset, double h, double l) {
+                offsets.insert(offsets.end(), offset, offset + dims);
+                high.push_back(h);
+                low.push_back(l);
+            }
+        };
+
+        // The 15-point Kronrod extension of the 7-point Gauss rule, exact
+        // for polynomials of degree 22 and 13 respectively.
+        Rule kronrod() {
+            static constexpr double NODES[] = {
+                0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+                0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+                0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+                0.207784955007898467600689403773245, 0.0,
+            };
+            static constexpr double KRONROD[] = {
+                0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+                0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+                0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+                0.204432940075298892414161999234649, 0.209482141084727828012999174891714,
+            };
+            // At the odd nodes.
+            static constexpr double GAUSS[] = {
+                0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+                0.381830050505118944950369775488975, 0.417959183673469387755102040816327,
+            };
+
+            Rule rule{ 1, {}, {}, {} };
+            for (int i = 0; i < 8; ++i) {
+                double gauss = i % 2 == 1 ? GAUSS[i / 2] / 2 : 0;
+                rule.add(&NODES[i], KRONROD[i] / 2, gauss);
+                if (i < 7) {
+                    double mirror = -NODES[i];
+                    rule.add(&mirror, KRONROD[i] / 2, gauss);
+                }
+            }
+            return rule;
+        }
+
+        // Genz and Malik's degree 7 rule with its embedded degree 5 rule.
+        // The points at +-LAMBDA2 and +-LAMBDA4 on axis i are points
+        // 1 + 4i to 4 + 4i, which split() takes differences of.
+        constexpr double LAMBDA2 = 0.35856858280031809199; // sqrt(9/70)
+        constexpr double LAMBDA4 = 0.94868329805051379960; // sqrt(9/10)
+        constexpr double LAMBDA5 = 0.68824720161168529772; // sqrt(9/19)
+
+        Rule genzMalik(size_t n) {
+            double d = static_cast<double>(n);
+            double w1 = (12824 - 9120 * d + 400 * d * d) / 19683;
+            double w2 = 980.0 / 6561;
+            double w3 = (1820 - 400 * d) / 19683;
+            double w4 = 200.0 / 19683;
+            double w5 = 6859.0 / 19683 / std::ldexp(1.0, static_cast<int>(n));
+            double e1 = (729 - 950 * d + 50 * d * d) / 729;
+            double e2 = 245.0 / 486;
+            double e3 = (265 - 100 * d) / 1458;
+            double e4 = 25.0 / 729;
+
+            Rule rule{ n, {}, {}, {} };
+            std::array<double, Cubature::ADAPTIVE> p{};
+            rule.add(p.data(), w1, e1);
+
+            for (size_t i = 0; i < n; ++i) {
+                for (double s : { LAMBDA2, -LAMBDA2 }) {
+                    p[i] = s;
+                    rule.add(p.data(), w2, e2);
+                }
+                for (double s : { LAMBDA4, -LAMBDA4 }) {
+                    p[i] = s;
+                    rule.add(p.data(), w3, e3);
+                }
+                p[i] = 0;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                for (size_t j = i + 1; j < n; ++j) {
+                    for (double s : { LAMBDA4, -LAMBDA4 }) {
+                        for (double t : { LAMBDA4, -LAMBDA4 }) {
+                            p[i] = s;
+                            p[j] = t;
+                            rule.add(p.data(), w4, e4);
+                        }
+                    }
+                    p[i] = p[j] = 0;
+                }
+            }
+            for (size_t corner = 0; corner < (size_t(1) << n); ++corner) {
+                for (size_t i = 0; i < n; ++i) {
+                    p[i] = corner >> i & 1 ? -LAMBDA5 : LAMBDA5;
+                }
+                rule.add(p.data(), w5, 0);
+            }
+            return rule;
+        }
+
+        struct Region {
+            std::array<double, Cubature::ADAPTIVE> center;
+            std::array<double, Cubature::ADAPTIVE> half;
+            double value;
+            double error;
+            size_t split;
+        };
+
+        // The axis along which the integrand's fourth difference is
+        // largest, preferring the widest on ties.
+        size_t split(const Rule& rule, const Region& region, const float* f) {
+            if (rule.dims == 1) return 0;
+
+            constexpr double RATIO = LAMBDA2 * LAMBDA2 / (LAMBDA4 * LAMBDA4);
+            size_t best = 0;
+            double most = -1;
+            for (size_t i = 0; i < rule.dims; ++i) {
+                const float* axis = f + 1 + 4 * i;
+                double diff = std::abs(axis[0] + axis[1] - 2.0 * f[0] - RATIO * (axis[2] + axis[3] - 2.0 * f[0]));
+                if (diff > most * (1 + 1e-10)) {
+                    most = diff;
+                    best = i;
+                } else if (diff >= most * (1 - 1e-10) && std::abs(region.half[i]) > std::abs(region.half[best])) {
+                    best = i;
+                }
+            }
+            return best;
+        }
+
+        // Applies `rule` to each region, setting its value, error and the
+        // axis to split it along.
+        void apply(const Rule& rule, Region* regions, size_t count, const Integrand& f, size_t workers, const Tracker& tracker) {
+            size_t dims = rule.dims;
+            size_t size = rule.size();
+            size_t total = count * size;
+            std::vector<float> values(total);
+
+            forEach((total + CHUNK - 1) / CHUNK, workers, [&](size_t c, Scratch& scratch) {
+                tracker.check();
+                size_t begin = c * CHUNK;
+                size_t m = std::min(CHUNK, total - begin);
+                scratch.coords.resize(dims * CHUNK);
+                for (size_t d = 0; d < dims; ++d) {
+                    float* row = scratch.coords.data() + d * CHUNK;
+                    for (size_t k = 0; k < m; ++k) {
+                        const Region& r = regions[(begin + k) / size];
+                        row[k] = static_cast<float>(r.center[d] + r.half[d] * rule.offsets[(begin + k) % size * dims + d]);
+                    }
+                    scratch.points[d] = row;
+                }
+                f(scratch.points, m, values.data() + begin, scratch.stack);
+                tracker.advance(m);
+            });
+
+            for (size_t i = 0; i < count; ++i) {
+                Region& r = regions[i];
+                const float* v = values.data() + i * size;
+                double volume = 1;
+                for (size_t d = 0; d < dims; ++d) {
+                    volume *= 2 * r.half[d];
+                }
+                double high = 0;
+                double low = 0;
+                for (size_t k = 0; k < size; ++k) {
+                    high += rule.high[k] * v[k];
+                    low += rule.low[k] * v[k];
+                }
+                r.value = volume * high;
+                r.error = std::abs(volume * (high - low));
+                r.split = split(rule, r, v);
+            }
+        }
+
+        Result adaptive(const Integrand& f, const double* lower, const double* upper, size_t dims,
+                        size_t workers, const Tracker& tracker) {
+            Rule rule = dims == 1 ? kronrod() : genzMalik(dims);
+            auto byError = [](const Region& a, const Region& b) { return a.error < b.error; };
+
+            std::vector<Region> heap(1);
+            for (size_t d = 0; d < dims; ++d) {
+                heap[0].center[d] = (lower[d] + upper[d]) / 2;
+                heap[0].half[d] = (upper[d] - lower[d]) / 2;
+            }
+            apply(rule, heap.data(), 1, f, workers, tracker);
+
+            Result result{ heap[0].value, heap[0].error, rule.size() };
+            std::vector<Region> batch;
+
+            while (!converged(result.value, result.error)) {
+                size_t room = (Cubature::MAX_EVALUATIONS - result.evaluations) / (2 * rule.size());
+                if (room == 0) break;
+
+                // Splits the worst regions, until the others alone would
+                // meet the tolerance on the whole estimate.
+                batch.clear();
+                double total = result.value;
+                double rest = result.error;
+                while (!heap.empty() && batch.size() < 2 * std::min(ROUND, room) && (batch.empty() || !converged(total, rest))) {
+                    std::pop_heap(heap.begin(), heap.end(), byError);
+                    Region r = heap.back();
+                    heap.pop_back();
+                    rest -= r.error;
+                    result.value -= r.value;
+                    result.error -= r.error;
+
+                    r.half[r.split] /= 2;
+                    Region a = r;
+                    Region b = r;
+                    a.center[r.split] -= r.half[r.split];
+                    b.center[r.split] += r.half[r.split];
+                    batch.push_back(a);
+                    batch.push_back(b);
+                }
+
+                apply(rule, batch.data(), batch.size(), f, workers, tracker);
+                result.evaluations += batch.size() * rule.size();
+                for (const Region& r : batch) {
+                    result.value += r.value;
+                    result.error += r.error;
+                    heap.push_back(r);
+                    std::push_heap(heap.begin(), heap.end(), byError);
+                }
+            }
+
+            // Summed afresh, so that rounding in the running totals does
+            // not reach the result.
+            result.value = 0;
+            result.error = 0;
+            for (const Region& r : heap) {
+                result.value += r.value;
+                result.error += r.error;
+            }
+            return result;
+        }
+
+        // Direction numbers for dimensions 2 to MAX_DIMENSIONS, from Joe and
+        // Kuo's new-joe-kuo-6.21201: the degree and middle coefficients of
+        // a primitive polynomial and the initial m_k.
+        struct Primitive {
+            int degree;
+            uint32_t a;
+            uint32_t m[6];
+        };
+
+        constexpr Primitive PRIMITIVES[Cubature::MAX_DIMENSIONS - 1] = {
+            { 1, 0, { 1 } },
+            { 2, 1, { 1, 3 } },
+            { 3, 1, { 1, 3, 1 } },
+            { 3, 2, { 1, 1, 1 } },
+            { 4, 1, { 1, 1, 3, 3 } },
+            { 4, 4, { 1, 3, 5, 13 } },
+            { 5, 2, { 1, 1, 5, 5, 17 } },
+            { 5, 4, { 1, 1, 5, 5, 5 } },
+            { 5, 7, { 1, 1, 7, 11, 19 } },
+            { 5, 11, { 1, 1, 5, 1, 1 } },
+            { 5, 13, { 1, 1, 1, 3, 11 } },
+            { 5, 14, { 1, 3, 5, 5, 31 } },
+            { 6, 1, { 1, 3, 3, 9, 7, 49 } },
+            { 6, 13, { 1, 1, 1, 15, 21, 21 } },
+            { 6, 16, { 1, 3, 1, 13, 27, 49 } },
+        };
+
+        constexpr int BITS = 32;
+
+        struct Sobol {
+            uint32_t v[Cubature::MAX_DIMENSIONS][BITS];
+
+            Sobol() {
+                for (int k = 0; k < BITS; ++k) {
+                    v[0][k] = uint32_t(1) << (BITS - 1 - k);
+                }
+                for (size_t d = 1; d < Cubature::MAX_DIMENSIONS; ++d) {
+                    const Primitive& p = PRIMITIVES[d - 1];
+                    uint32_t* w = v[d];
+                    for (int k = 0; k < p.degree; ++k) {
+                        w[k] = p.m[k] << (BITS - 1 - k);
+                    }
+                    for (int k = p.degree; k < BITS; ++k) {
+                        w[k] = w[k - p.degree] ^ (w[k - p.degree] >> p.degree);
+                        for (int l = 1; l < p.degree; ++l) {
+                            if (p.a >> (p.degree - 1 - l) & 1) w[k] ^= w[k - l];
+                        }
+                    }
+                }
+            }
+        };
+
+        const Sobol& sobol() {
+            static const Sobol table;
+            return table;
+        }
+
+        uint64_t splitmix(uint64_t& state) {
+            uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        }
+
+        Result quasiMonteCarlo(const Integrand& f, const double* lower, const double* upper, size_t dims,
+                               size_t workers, const Tracker& tracker) {
+            constexpr size_t R = Cubature::REPLICATES;
+            const Sobol& table = sobol();
+
+            uint32_t shifts[R][Cubature::MAX_DIMENSIONS];
+            uint64_t state = Cubature::SEED;
+            for (size_t r = 0; r < R; ++r) {
+                for (size_t d = 0; d < dims; ++d) {
+                    shifts[r][d] = static_cast<uint32_t>(splitmix(state) >> 32);
+                }
+            }
+
+            double volume = 1;
+            for (size_t d = 0; d < dims; ++d) {
+                volume *= upper[d] - lower[d];
+            }
+
+            double sums[R] = {};
+            size_t n = 0;
+            Result result{ 0, std::numeric_limits<double>::infinity(), 0 };
+
+            for (size_t target = FIRST; R * target <= Cubature::MAX_EVALUATIONS; target *= 2) {
+                // Each replicate's new points, CHUNK at a time; the partial
+                // sums are added in order once all are done.
+                size_t chunks = (target - n) / CHUNK;
+                std::vector<double> partial(R * chunks);
+
+                forEach(R * chunks, workers, [&](size_t item, Scratch& scratch) {
+                    tracker.check();
+                    size_t r = item / chunks;
+                    uint32_t begin = static_cast<uint32_t>(n + item % chunks * CHUNK);
+                    scratch.coords.resize(dims * CHUNK);
+                    scratch.values.resize(CHUNK);
+
+                    for (size_t d = 0; d < dims; ++d) {
+                        const uint32_t* v = table.v[d];
+                        // Points are taken in Gray code order, so each
+                        // differs from the one before in a single bit.
+                        uint32_t gray = begin ^ (begin >> 1);
+                        uint32_t x = 0;
+                        for (int k = 0; gray != 0; ++k, gray >>= 1) {
+                            if (gray & 1) x ^= v[k];
+                        }
+
+                        float* row = scratch.coords.data() + d * CHUNK;
+                        double width = upper[d] - lower[d];
+                        for (size_t i = 0; i < CHUNK; ++i) {
+                            double u = (static_cast<double>(x ^ shifts[r][d]) + 0.5) * 0x1p-32;
+                            row[i] = static_cast<float>(lower[d] + width * u);
+                            x ^= v[std::countr_zero(static_cast<uint32_t>(begin + i + 1))];
+                        }
+                        scratch.points[d] = row;
+                    }
+
+                    f(scratch.points, CHUNK, scratch.values.data(), scratch.stack);
+                    double sum = 0;
+                    for (float value : scratch.values) {
+                        sum += value;
+                    }
+                    partial[item] = sum;
+                    tracker.advance(CHUNK);
+                });
+
+                for (size_t item = 0; item < partial.size(); ++item) {
+                    sums[item / chunks] += partial[item];
+                }
+                n = target;
+                result.evaluations = R * n;
+
+                double mean = 0;
+                for (double sum : sums) {
+                    mean += sum / n;
+                }
+                mean /= R;
+                double spread = 0;
+                for (double sum : sums) {
+                    spread += (sum / n - mean) * (sum / n - mean);
+                }
+                result.value = volume * mean;
+                result.error = std::abs(volume) * std::sqrt(spread / (R * (R - 1)));
+
+                if (converged(result.value, result.error)) break;
+            }
+            return result;
+        }
+    }
+
+    Cubature::Result Cubature::integrate(const Integrand& f, const double* lower, const double* upper, size_t dims,
+                                         size_t workers, Progress* progress) {
+        Tracker tracker{ progress, progress != nullptr && progress->claim(MAX_EVALUATIONS) };
+
+        Result result = dims <= ADAPTIVE
+            ? adaptive(f, lower, upper, dims, workers, tracker)
+            : quasiMonteCarlo(f, lower, upper, dims, workers, tracker);
+
+        // Completes the claim, so that a loop after this one can report.
+        if (result.evaluations < MAX_EVALUATIONS) {
+            tracker.advance(MAX_EVALUATIONS - result.evaluations);
+        }
+        return result;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "progress.h"
+
+namespace Acalc {
+
+    // Integrates a function over a box. Up to ADAPTIVE dimensions the box
+    // is split adaptively: the region with the largest error estimate is
+    // halved and both halves integrated again, with a 15-point Gauss-Kronrod
+    // rule in one dimension and the Genz-Malik degree 7 rule above that.
+    // The error estimate is the gap between each rule and the lower degree
+    // rule embedded in it. Higher dimensions use quasi-Monte Carlo: Sobol
+    // points (Joe-Kuo direction numbers) under REPLICATES independent random
+    // digital shifts, doubling the points until the replicates agree; the
+    // error estimate is their standard error.
+    //
+    // Both stop at max(ABSOLUTE, RELATIVE * |value|) or after about
+    // MAX_EVALUATIONS evaluations. Points are evaluated in batches, which
+    // are spread over `workers` threads. The shifts
+    // are seeded from SEED, and the batches are summed in a fixed order,
+    // so a result does not depend on the number of threads.
+    class Cubature {
+        public:
+            static constexpr size_t ADAPTIVE = 3;
+            static constexpr size_t MAX_DIMENSIONS = 16;
+            static constexpr double RELATIVE = 1e-6;
+            static constexpr double ABSOLUTE = 1e-9;
+            static constexpr size_t MAX_EVALUATIONS = size_t(1) << 21;
+            static constexpr size_t REPLICATES = 8;
+            static constexpr uint64_t SEED = 0x5eed5eed5eed5eedull;
+
+            // Writes f at `n` points to `out`; points[d][i] is coordinate d
+            // of point i. `stack` is the calling thread's scratch space. The
+            // function is called from several threads at once if `workers`
+            // is above 1.
+            using Integrand = std::function<void(const float* const* points, size_t n, float* out, std::vector<float>& stack)>;
+
+            struct Result {
+                double value;
+                double error;
+                size_t evaluations;
+            };
+
+            // `lower` and `upper` hold `dims` limits each. `progress` is
+            // polled before every batch.
+            static Result integrate(const Integrand& f, const double* lower, const double* upper, size_t dims,
+                                    size_t workers, Progress* progress = nullptr);
+    };
+}
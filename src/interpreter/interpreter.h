@@ -1,72 +1,384 @@
 #pragma once
 
 #include <memory>
+#include <chrono>
 #include <cmath>
+#include <exception>
+#include <fstream>
 #include <iostream>
 #include "../parser/expr.h"
 #include "../environment/environment.h"
-#include "../graph/engine.h"
+#include "program.h"
+#include "bindings.h"
+#include "sampler.h"
+#include "contour.h"
+#include "table.h"
+#include "progress.h"
+#include "../canvas/canvas.h"
 
 namespace Acalc {
 
-    class Interpreter : public ExprVisitor, public StmtVisitor {
+    // What an embedder allows one interpreter's statements to use.
+    struct InterpreterOptions {
+        // Threads a single implicit, table or named-variable integ may run
+        // on, 0 for one per core. Embedders running many interpreters at
+        // once, such as the server, set 1 so they do not oversubscribe.
+        size_t workers = 0;
+
+        // Whether `table ... into "path"` may write files. Embedders that
+        // take scripts from others, such as the server, turn this off.
+        bool files = true;
+    };
+
+    class Interpreter : public StmtVisitor {
         public:
+            // `print` writes to `out`.
+            Interpreter(Canvas& canvas, std::ostream& out = std::cout, InterpreterOptions options = {})
+            : canvas{canvas}, out{out}, options{options}, compiler{env, &memo, &progress, options.workers} {}
+
+            // Throws without running the statement once cancelled. Curves
+            // reading a variable the statement wrote are then resampled.
             void interpret(const std::unique_ptr<Stmt>& expr) {
+                progress.check();
+                progress.begin();
                 expr->accept(this);
+                if (bindings.sweep()) {
+                    refresh();
+                }
+            }
+
+            float evaluate(Expr* expr) {
+                compiler.compile(expr, scratch);
+                return scratch.run(stack);
+            }
+
+            Program compile(Expr* expr) {
+                Program program;
+                compiler.compile(expr, program);
+                return program;
+            }
+
+            const MemoCache::Stats& memoStats() const {
+                return memo.stats();
+            }
+
+            // Whether an `exit` statement has run. Stopping is left to the
+            // caller, so that an embedded interpreter never ends the process.
+            bool exited() const {
+                return stopped;
+            }
+
+            // Cancelling makes the running statement fail at its next yield
+            // point, and the statements after it fail at once, until reset.
+            Progress& getProgress() {
+                return progress;
+            }
+
+            const Progress& getProgress() const {
+                return progress;
+            }
+
+            // Redraws now if a redefinition left curves waiting for a frame.
+            void flush() {
+                if (bindings.dirty()) {
+                    redraw();
+                }
             }
 
         private:
+            // Redefinitions closer together than this are coalesced into
+            // one redraw.
+            static constexpr std::chrono::milliseconds FRAME{ 16 };
+            static constexpr float START = -400;
+            static constexpr float END = 400;
+            static constexpr size_t YIELD = 256;
+
+            // A point, or points joined by lines, drawn by plot, line,
+            // pgraph or polar.
+            struct Mark {
+                std::vector<Point> points;
+                bool joined;
+            };
+
+            // Under `precision dd`, print, var and expression statements
+            // are evaluated in double-double; everything drawn stays in
+            // float, reading the variables' rounded values.
+            DD evaluateDD(Expr* expr) {
+                compiler.compile(expr, scratch);
+                return scratch.runDD(wideStack);
+            }
 
             void visitExprStmt(ExprStmt* es) override {
-                es->getExpr()->accept(this);
+                if (precision == Precision::DOUBLE_DOUBLE) {
+                    evaluateDD(es->getExpr());
+                } else {
+                    evaluate(es->getExpr());
+                }
             }
 
             void visitPrintStmt(PrintStmt* ps) override {
-                float val = ps->getExpr()->accept(this);
-                std::cout << val << std::endl;
+                if (precision == Precision::DOUBLE_DOUBLE) {
+                    out << evaluateDD(ps->getExpr()).format() << std::endl;
+                } else {
+                    out << evaluate(ps->getExpr()) << std::endl;
+                }
             }
 
             void visitVariableStmt(VariableStmt* vs) override {
-                float val = 0;
-                if (vs->getExpr() != nullptr) {
-                    val = vs->getExpr()->accept(this);
+                if (precision == Precision::DOUBLE_DOUBLE) {
+                    DD val;
+                    if (vs->getExpr() != nullptr) {
+                        val = evaluateDD(vs->getExpr());
+                    }
+                    env.define(vs->getVariable(), val);
+                } else {
+                    float val = 0;
+                    if (vs->getExpr() != nullptr) {
+                        val = evaluate(vs->getExpr());
+                    }
+                    env.define(vs->getVariable(), val);
                 }
-                env.define(vs->getVariable(), val);
             }
 
+            // The sampled curve is memoized as a whole, keyed on the formula
+            // and the versions of every variable it reads except x. It then
+            // stays bound, and is resampled when one of those variables is
+            // redefined.
             void visitGraphStmt(GraphStmt* gs) override {
-                float start = -400;
-                float end = 400;
+                Program program = compile(gs->getExpr());
+                Environment::Slot& x = env.slot("x");
+
+                std::vector<uint64_t> key;
+                program.key(key, &x);
+
+                std::vector<float> samples;
+                if (const std::vector<float>* hit = memo.find(key)) {
+                    samples = *hit;
+                    x.set(lastSample());
+                } else {
+                    sample(program, x, samples);
+                    memo.insert(key, samples);
+                }
+
+                size_t id = bindings.bind(std::move(program), &x);
+                Bindings::Curve& curve = bindings.all()[id];
+                curve.points = points(samples);
+                curve.dirty = false;
+                canvas.curve(id, curve.points);
+            }
+
+            // A formula without integ is run a batch of abscissas at a
+            // time; the others one at a time, as integ needs.
+            void sample(const Program& program, Environment::Slot& x, std::vector<float>& samples) {
+                const std::vector<float>& xs = abscissas();
+                bool reporting = progress.claim(static_cast<uint64_t>((END - START) / 0.05f));
+                samples.resize(xs.size());
+                for (size_t begin = 0; begin < xs.size(); begin += YIELD) {
+                    progress.check();
+                    if (reporting) progress.advance(YIELD);
+
+                    size_t end = std::min(xs.size(), begin + YIELD);
+                    if (program.pure()) {
+                        program.runBatch(&x, xs.data() + begin, samples.data() + begin, end - begin, stack);
+                        continue;
+                    }
+                    for (size_t i = begin; i < end; ++i) {
+                        x.set(xs[i]);
+                        samples[i] = program.run(stack);
+                    }
+                }
+            }
+
+            // The abscissas of the samples. The loop accumulates in float,
+            // so they are found by running it once.
+            static const std::vector<float>& abscissas() {
+                static const std::vector<float> xs = []() {
+                    std::vector<float> xs;
+                    for (float i = START; i < END; i+=0.05) {
+                        xs.push_back(i);
+                    }
+                    return xs;
+                }();
+                return xs;
+            }
+
+            // Where sample() leaves x.
+            static float lastSample() {
+                return abscissas().back();
+            }
 
-                for (float i = start; i < end; i+=0.05) {
-                    env.define("x", i);
-                    float val = gs->getExpr()->accept(this);
-                    Graph::Engine::plot(400 + i, 300 - val);
+            static std::vector<Point> points(const std::vector<float>& samples) {
+                const std::vector<float>& xs = abscissas();
+                std::vector<Point> out;
+                out.reserve(samples.size());
+                for (size_t k = 0; k < samples.size() && k < xs.size(); ++k) {
+                    out.push_back({ 400 + xs[k], 300 - samples[k] });
+                }
+                return out;
+            }
+
+            void refresh() {
+                if (std::chrono::steady_clock::now() - lastFrame >= FRAME) {
+                    redraw();
+                }
+            }
+
+            // Only the dirty curves are evaluated. A retained canvas is then
+            // handed just those curves; any other canvas cannot erase a
+            // single curve, so it is cleaned and the other curves and the
+            // marks are replayed from the points they already have. A
+            // curve that fails is left blank and the first error is
+            // reported once the frame is drawn.
+            void redraw() {
+                Environment::Slot& x = env.slot("x");
+                bool retained = canvas.retained();
+                std::exception_ptr error;
+
+                if (!retained) {
+                    canvas.clean();
+                    for (const Mark& mark : marks) {
+                        if (mark.joined) {
+                            canvas.polyline(mark.points);
+                        } else {
+                            canvas.plot(mark.points[0].x, mark.points[0].y);
+                        }
+                    }
+                }
+
+                std::vector<Bindings::Curve>& curves = bindings.all();
+                for (size_t id = 0; id < curves.size(); ++id) {
+                    Bindings::Curve& curve = curves[id];
+                    bool changed = curve.dirty;
+                    if (changed) {
+                        curve.dirty = false;
+                        try {
+                            sample(curve.program, x, resampled);
+                            curve.points = points(resampled);
+                        } catch (...) {
+                            curve.points.clear();
+                            if (!error) error = std::current_exception();
+                        }
+                    }
+                    if (changed || !retained) {
+                        canvas.curve(id, curve.points);
+                    }
+                }
+
+                bindings.settle();
+                lastFrame = std::chrono::steady_clock::now();
+
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+
+            // Marks are kept only for canvases that do not keep them.
+            void mark(const std::vector<Point>& points, bool joined) {
+                if (!canvas.retained()) {
+                    marks.push_back({ points, joined });
+                }
+            }
+
+            void visitPGraphStmt(PGraphStmt* ps) override {
+                float start = evaluate(ps->getStart());
+                float end = evaluate(ps->getEnd());
+                Program fx = compile(ps->getX());
+                Program fy = compile(ps->getY());
+                Environment::Slot& t = env.slot("t");
+
+                trace(start, end, [&](const std::vector<float>& ts, std::vector<Point>& out) {
+                    xs.resize(ts.size());
+                    ys.resize(ts.size());
+                    fx.runBatch(&t, ts.data(), xs.data(), ts.size(), lanes, Program::Faults::QUIET);
+                    fy.runBatch(&t, ts.data(), ys.data(), ts.size(), lanes, Program::Faults::QUIET);
+                    for (size_t i = 0; i < ts.size(); ++i) {
+                        out[i] = { 400 + xs[i], 300 - ys[i] };
+                    }
+                });
+            }
+
+            void visitPolarStmt(PolarStmt* ps) override {
+                float start = evaluate(ps->getStart());
+                float end = evaluate(ps->getEnd());
+                Program r = compile(ps->getRadius());
+                Environment::Slot& t = env.slot("t");
+
+                trace(start, end, [&](const std::vector<float>& ts, std::vector<Point>& out) {
+                    xs.resize(ts.size());
+                    r.runBatch(&t, ts.data(), xs.data(), ts.size(), lanes, Program::Faults::QUIET);
+                    for (size_t i = 0; i < ts.size(); ++i) {
+                        out[i] = { 400 + xs[i] * std::cos(ts[i]), 300 - xs[i] * std::sin(ts[i]) };
+                    }
+                });
+            }
+
+            void visitImplicitStmt(ImplicitStmt* is) override {
+                Program f = compile(is->getExpr());
+
+                std::vector<Point> segments;
+                Contour::trace(f, &env.slot("x"), &env.slot("y"), segments, &progress, options.workers);
+
+                for (size_t i = 0; i + 1 < segments.size(); i += 2) {
+                    mark({ segments[i], segments[i + 1] }, true);
+                    canvas.line(segments[i].x, segments[i].y, segments[i + 1].x, segments[i + 1].y);
+                }
+            }
+
+            // `map` evaluates with Faults::QUIET, so a point where the curve
+            // is undefined, such as a pole, comes back infinite or NaN and
+            // the sampler breaks the curve there instead of the statement
+            // failing.
+            template <typename Map>
+            void trace(float start, float end, Map&& map) {
+                if (!std::isfinite(start) || !std::isfinite(end)) {
+                    throw std::runtime_error("Error: parameter range must be finite");
+                }
+
+                // Every refinement level is a yield point.
+                bool reporting = progress.claim(Sampler::LEVELS + 1);
+                auto step = [&](const std::vector<float>& ts, std::vector<Point>& out) {
+                    progress.check();
+                    map(ts, out);
+                    if (reporting) progress.advance(1);
+                };
+
+                std::vector<std::vector<Point>> lines;
+                sampler.trace(start, end, step, lines);
+                for (std::vector<Point>& line : lines) {
+                    mark(line, true);
+                    canvas.polyline(std::move(line));
                 }
             }
 
             void visitPlotStmt(PlotStmt* ps) override {
-                Graph::Engine::plot(ps->getFirstExpr()->accept(this), ps->getSecondExpr()->accept(this));
+                Point p{ evaluate(ps->getFirstExpr()), evaluate(ps->getSecondExpr()) };
+                mark({ p }, false);
+                canvas.plot(p.x, p.y);
             }
 
             void visitLineStmt(LineStmt* ls) override {
-                Graph::Engine::line(ls->getFirstExpr()->accept(this), ls->getSecondExpr()->accept(this), ls->getThirdExpr()->accept(this), ls->getFourthExpr()->accept(this));
+                Point a{ evaluate(ls->getFirstExpr()), evaluate(ls->getSecondExpr()) };
+                Point b{ evaluate(ls->getThirdExpr()), evaluate(ls->getFourthExpr()) };
+                mark({ a, b }, true);
+                canvas.line(a.x, a.y, b.x, b.y);
             }
 
             void visitShowStmt(ShowStmt* ss) override {
-                Graph::Engine::show();
+                canvas.show();
             }
 
             void visitHideStmt(HideStmt* hs) override {
-                Graph::Engine::hide();
+                canvas.hide();
             }
 
             void visitExitStmt(ExitStmt* es) override {
-                Graph::Engine::exit();
-                exit(0);
+                canvas.exit();
+                stopped = true;
             }
 
+            // Only an interpreter printing to the terminal has a screen to clear.
             void visitClearStmt(ClearStmt* cs) override {
+                if (&out != &std::cout) return;
 #ifdef _WIN32
                 system("cls");
 #elif __linux__ || __APPLE__ 
@@ -74,77 +386,71 @@ namespace Acalc {
 #endif
             }
 
-            void visitCleanStmt(CleanStmt* cs) override {
-                Graph::Engine::clean();
-            }
-
-            float visitLiteralExpr(LiteralExpr* expr) override {
-                return expr->getValue();
-            }
-
-            float visitUnaryExpr(UnaryExpr* expr) override {
-                float val = expr->getExpr()->accept(this);
-                switch (expr->getOperator().type) {
-                    case TOKEN_MINUS: return -val;
-                    case TOKEN_SIN: return std::sin(val);
-                    case TOKEN_COS: return std::cos(val);
-                    case TOKEN_TAN: return std::tan(val);
-                    case TOKEN_COSEC: return 1.0f / std::sin(val);
-                    case TOKEN_SEC: return 1.0f / std::cos(val);
-                    case TOKEN_COT: return 1.0f / std::tan(val);
-                    case TOKEN_LOG: return std::log(val);
-                    case TOKEN_ABS: return std::abs(val);
-                    default: break;
-                }
-                return val;
-            }
-
-            float visitBinaryExpr(BinaryExpr* expr) override {
-                float left = expr->getLeft()->accept(this);
-                float right = expr->getRight()->accept(this);
-                switch (expr->getOperator().type) {
-                    case TOKEN_PLUS: return left + right; break;
-                    case TOKEN_MINUS: return left - right; break;
-                    case TOKEN_STAR: return left * right; break;
-                    case TOKEN_SLASH: {
-                        if (right == 0) {
-                            throw std::runtime_error("Error: Division by zero");
-                        }
-                        return left / right; break;
-                    }
-                    case TOKEN_POWER: {
-                        if (left < 0 && right != std::floor(right)) {
-                            throw std::runtime_error("Error: Negative base to non-integer power");
-                        }
-                        return std::pow(left, right); break;
-                    }
-                    default:
-                        return 0;
-                }
-                return 0;
-            }
-
-            float visitIdentifierExpr(IdentifierExpr* expr) override {
-                return env.get(expr->getVariable());
+            void visitPrecisionStmt(PrecisionStmt* ps) override {
+                precision = ps->getPrecision();
             }
 
-            float visitIntegExpr(IntegExpr* expr) override {
-                float limit_start = expr->getLimitStart()->accept(this);
-                float limit_end = expr->getLimitEnd()->accept(this);
+            // The range is read in double-double whatever the precision, so
+            // that a step such as 0.1 is not rounded to float and the rows
+            // do not drift from the decimal values; the rows themselves are
+            // evaluated in float.
+            void visitTableStmt(TableStmt* ts) override {
+                const std::string& path = ts->getPath();
+                if (!path.empty() && !options.files) {
+                    throw std::runtime_error("Error: writing files is disabled");
+                }
 
-                float result = 0.0f;
-                int n = 100000;
+                double start = evaluateDD(ts->getStart()).hi;
+                double end = evaluateDD(ts->getEnd()).hi;
+                double step = evaluateDD(ts->getStep()).hi;
+                uint64_t rows = Table::rows(start, end, step);
+                Program f = compile(ts->getExpr());
+                Environment::Slot* x = &env.slot("x");
 
-                float h = (limit_end - limit_start) / n;
+                if (path.empty()) {
+                    Table::write(f, x, start, step, rows, out, &progress, options.workers);
+                    out.flush();
+                    return;
+                }
 
-                for (int i = 1; i <=n; ++i) {
-                    env.define("x", limit_start + i * h);
-                    result += expr->getFormula()->accept(this);
+                std::ofstream file(path, std::ios::binary);
+                if (!file) {
+                    throw std::runtime_error("Error: cannot open " + path);
+                }
+                Table::write(f, x, start, step, rows, file, &progress, options.workers);
+                file.close();
+                if (file.fail()) {
+                    throw std::runtime_error("Error: cannot write " + path);
                 }
-                
-                return result * h;
             }
+
+            void visitCleanStmt(CleanStmt* cs) override {
+                bindings.clear();
+                marks.clear();
+                canvas.clean();
+            }
+
         private:
+            Canvas& canvas;
+            std::ostream& out;
+            InterpreterOptions options;
+            bool stopped = false;
             Environment env;
+            MemoCache memo;
+            Progress progress;
+            Compiler compiler;
+            Program scratch;
+            std::vector<float> stack;
+            // Scratch for resampling a curve.
+            std::vector<float> resampled;
+            std::vector<DD> wideStack;
+            Precision precision = Precision::FLOAT;
+            Bindings bindings;
+            std::vector<Mark> marks;
+            Sampler sampler;
+            std::vector<float> lanes;
+            std::vector<float> xs;
+            std::vector<float> ys;
+            std::chrono::steady_clock::time_point lastFrame;
     };
 }
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace Acalc {
+
+    // Bounded least-recently-used store of evaluation results.
+    //
+    // A key is the structural hash of the expression followed by everything
+    // its result depends on: the versions of the variables it reads and,
+    // for integ, the bit patterns of its limits. Values are the result
+    // itself (one float for an integ, every sample for a graph).
+    class MemoCache {
+        public:
+            struct Stats {
+                uint64_t hits = 0;
+                uint64_t misses = 0;
+                uint64_t evictions = 0;
+                size_t entries = 0;
+                size_t bytes = 0;
+            };
+
+            MemoCache(size_t capacity = 64 << 20) : capacity{capacity} {}
+
+            const std::vector<float>* find(const std::vector<uint64_t>& key) {
+                auto it = index.find(hash(key));
+                if (it == index.end() || it->second->key != key) {
+                    ++counters.misses;
+                    return nullptr;
+                }
+                entries.splice(entries.begin(), entries, it->second);
+                ++counters.hits;
+                return &it->second->values;
+            }
+
+            void insert(const std::vector<uint64_t>& key, std::vector<float> values) {
+                size_t size = bytes(key, values);
+                if (size > capacity) return;
+
+                uint64_t h = hash(key);
+                auto it = index.find(h);
+                if (it != index.end()) {
+                    erase(it);
+                }
+
+                while (counters.bytes + size > capacity && !entries.empty()) {
+                    erase(index.find(entries.back().hash));
+                    ++counters.evictions;
+                }
+
+                entries.push_front({ h, key, std::move(values) });
+                index[h] = entries.begin();
+                counters.bytes += size;
+                counters.entries = entries.size();
+            }
+
+            void clear() {
+                entries.clear();
+                index.clear();
+                counters.bytes = 0;
+                counters.entries = 0;
+            }
+
+            const Stats& stats() const { return counters; }
+
+        private:
+            struct Entry {
+                uint64_t hash;
+                std::vector<uint64_t> key;
+                std::vector<float> values;
+            };
+
+            using Index = std::unordered_map<uint64_t, std::list<Entry>::iterator>;
+
+            static uint64_t hash(const std::vector<uint64_t>& key) {
+                uint64_t h = 0xcbf29ce484222325ull;
+                for (uint64_t word : key) {
+                    h = (h ^ word) * 0x100000001b3ull;
+                    h ^= h >> 29;
+                }
+                return h;
+            }
+
+            static size_t bytes(const std::vector<uint64_t>& key, const std::vector<float>& values) {
+                return sizeof(Entry) + key.size() * sizeof(uint64_t) + values.size() * sizeof(float);
+            }
+
+            void erase(Index::iterator it) {
+                counters.bytes -= bytes(it->second->key, it->second->values);
+                entries.erase(it->second);
+                index.erase(it);
+                counters.entries = entries.size();
+            }
+
+        private:
+            size_t capacity;
+            std::list<Entry> entries;
+            Index index;
+            Stats counters;
+    };
+}
@@ -0,0 +1,693 @@
+#include "program.h"
+#include "cubature.h"
+#include "workers.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace Acalc {
+
+    void Compiler::compile(Expr* expr, Program& out) {
+        program = &out;
+        out.code.clear();
+        out.constants.clear();
+        out.slots.clear();
+        out.names.clear();
+        out.integrals.clear();
+        out.x = nullptr;
+        out.err = nullptr;
+        out.memo = memo;
+        out.progress = progress;
+        out.workers = workers;
+        out.depth = 0;
+        height = 0;
+
+        tasks.push_back({ expr, EXPAND });
+
+        while (!tasks.empty()) {
+            Task task = tasks.back();
+            tasks.pop_back();
+
+            switch (task.step) {
+                case EXPAND: task.node->accept(this); break;
+                case EMIT: emit(task.op); break;
+                case OPEN_BODY: {
+                    bodies.push_back(program->code.size());
+                    emit(Program::OP_SKIP);
+                } break;
+                case CLOSE_BODY: {
+                    size_t skip = bodies.back();
+                    bodies.pop_back();
+                    program->code[skip].arg = static_cast<uint32_t>(program->code.size() - skip - 1);
+                    // The body's result is consumed by OP_INTEG, not left on the stack.
+                    --height;
+
+                    Program::Integral integral{ skip + 1, program->code.size(), 0, {}, {}, true };
+                    if (task.op == Program::OP_MULTI_INTEG) {
+                        auto* multi = static_cast<MultiIntegExpr*>(task.node);
+                        for (const std::string& name : multi->getVariables()) {
+                            integral.vars.push_back(&env.slot(name));
+                        }
+                        if (program->err == nullptr) {
+                            program->err = &env.slot("err");
+                        }
+                    } else if (program->x == nullptr) {
+                        program->x = &env.slot("x");
+                    }
+
+                    // The variables integ binds itself are not dependencies.
+                    auto bound = [&](const Environment::Slot* slot) {
+                        if (integral.vars.empty()) return slot == program->x;
+                        return std::find(integral.vars.begin(), integral.vars.end(), slot) != integral.vars.end();
+                    };
+
+                    integral.shape = program->hash(integral.body, integral.body_end);
+                    for (size_t pc = integral.body; pc < integral.body_end; ++pc) {
+                        const Program::Instr& in = program->code[pc];
+                        if (in.op == Program::OP_LOAD && !bound(program->slots[in.arg])) {
+                            integral.deps.push_back(program->slots[in.arg]);
+                        } else if (in.op == Program::OP_SKIP) {
+                            integral.pure = false;
+                        }
+                    }
+                    closed.push_back(program->integrals.size());
+                    program->integrals.push_back(std::move(integral));
+                } break;
+                case EMIT_INTEG: {
+                    bool named = !program->integrals[closed.back()].vars.empty();
+                    emit(named ? Program::OP_MULTI_INTEG : Program::OP_INTEG, static_cast<uint32_t>(closed.back()));
+                    closed.pop_back();
+                } break;
+            }
+        }
+    }
+
+    void Compiler::emit(Program::OpCode op, uint32_t arg, float val) {
+        program->code.push_back({ op, arg, val });
+
+        switch (op) {
+            case Program::OP_CONST:
+            case Program::OP_LOAD:
+            case Program::OP_UNDECLARED: ++height; break;
+            case Program::OP_ADD:
+            case Program::OP_SUB:
+            case Program::OP_MUL:
+            case Program::OP_DIV:
+            case Program::OP_POW:
+            case Program::OP_INTEG: --height; break;
+            case Program::OP_MULTI_INTEG: height -= 2 * program->integrals[arg].vars.size() - 1; break;
+            default: break;
+        }
+        program->depth = std::max(program->depth, height);
+    }
+
+    float Compiler::visitLiteralExpr(LiteralExpr* expr) {
+        emit(Program::OP_CONST, static_cast<uint32_t>(program->constants.size()), expr->getValue());
+        program->constants.push_back(expr->getExact());
+        return 0;
+    }
+
+    float Compiler::visitIdentifierExpr(IdentifierExpr* expr) {
+        if (Environment::Slot* slot = env.find(expr->getVariable())) {
+            emit(Program::OP_LOAD, static_cast<uint32_t>(program->slots.size()));
+            program->slots.push_back(slot);
+        } else {
+            // Reported when evaluation reaches it, as a tree walk would.
+            emit(Program::OP_UNDECLARED, static_cast<uint32_t>(program->names.size()));
+            program->names.push_back(expr->getVariable());
+        }
+        return 0;
+    }
+
+    float Compiler::visitUnaryExpr(UnaryExpr* expr) {
+        Program::OpCode op;
+        switch (expr->getOperator().type) {
+            case TOKEN_MINUS: op = Program::OP_NEG; break;
+            case TOKEN_SIN: op = Program::OP_SIN; break;
+            case TOKEN_COS: op = Program::OP_COS; break;
+            case TOKEN_TAN: op = Program::OP_TAN; break;
+            case TOKEN_COSEC: op = Program::OP_COSEC; break;
+            case TOKEN_SEC: op = Program::OP_SEC; break;
+            case TOKEN_COT: op = Program::OP_COT; break;
+            case TOKEN_LOG: op = Program::OP_LOG; break;
+            case TOKEN_ABS: op = Program::OP_ABS; break;
+            default: {
+                // Unary plus leaves its operand unchanged.
+                tasks.push_back({ expr->getExpr(), EXPAND });
+                return 0;
+            }
+        }
+        tasks.push_back({ nullptr, EMIT, op });
+        tasks.push_back({ expr->getExpr(), EXPAND });
+        return 0;
+    }
+
+    float Compiler::visitBinaryExpr(BinaryExpr* expr) {
+        Program::OpCode op;
+        switch (expr->getOperator().type) {
+            case TOKEN_PLUS: op = Program::OP_ADD; break;
+            case TOKEN_MINUS: op = Program::OP_SUB; break;
+            case TOKEN_STAR: op = Program::OP_MUL; break;
+            case TOKEN_SLASH: op = Program::OP_DIV; break;
+            case TOKEN_POWER: op = Program::OP_POW; break;
+            default: throw std::runtime_error("Error: unknown operator " + expr->getOperator().lexeme);
+        }
+        tasks.push_back({ nullptr, EMIT, op });
+        tasks.push_back({ expr->getRight(), EXPAND });
+        tasks.push_back({ expr->getLeft(), EXPAND });
+        return 0;
+    }
+
+    float Compiler::visitIntegExpr(IntegExpr* expr) {
+        tasks.push_back({ nullptr, EMIT_INTEG });
+        tasks.push_back({ expr->getLimitEnd(), EXPAND });
+        tasks.push_back({ expr->getLimitStart(), EXPAND });
+        tasks.push_back({ nullptr, CLOSE_BODY, Program::OP_INTEG });
+        tasks.push_back({ expr->getFormula(), EXPAND });
+        tasks.push_back({ nullptr, OPEN_BODY });
+        return 0;
+    }
+
+    float Compiler::visitMultiIntegExpr(MultiIntegExpr* expr) {
+        const std::vector<std::string>& variables = expr->getVariables();
+        if (variables.size() > Cubature::MAX_DIMENSIONS) {
+            throw std::runtime_error("Error: integ takes at most " + std::to_string(Cubature::MAX_DIMENSIONS) + " variables");
+        }
+        // Declared before the body is compiled, which reads them.
+        for (const std::string& name : variables) {
+            env.bind(name);
+        }
+
+        tasks.push_back({ nullptr, EMIT_INTEG });
+        for (size_t i = 2 * variables.size(); i-- > 0;) {
+            tasks.push_back({ expr->getLimit(i), EXPAND });
+        }
+        tasks.push_back({ expr, CLOSE_BODY, Program::OP_MULTI_INTEG });
+        tasks.push_back({ expr->getFormula(), EXPAND });
+        tasks.push_back({ nullptr, OPEN_BODY });
+        return 0;
+    }
+
+    float Program::run(std::vector<float>& stack) const {
+        if (stack.size() < depth) {
+            stack.resize(depth);
+        }
+        exec(0, code.size(), stack.data());
+        return stack[0];
+    }
+
+    void Program::runBatch(Environment::Slot* param, const float* params, float* out, size_t n, std::vector<float>& stack,
+                           Faults faults) const {
+        if (n == 0) return;
+
+        Lane lane{ param, params };
+        runBatch(&lane, 1, out, n, stack, faults);
+        param->set(params[n - 1]);
+    }
+
+    void Program::runBatch(const Lane* lanes, size_t count, float* out, size_t n, std::vector<float>& stack,
+                           Faults faults) const {
+        execBatch(0, code.size(), integrals.empty(), lanes, count, out, n, stack, faults);
+    }
+
+    // The instructions in [begin, end) leave a single value; `pure` says
+    // they hold no integ.
+    void Program::execBatch(size_t begin, size_t end, bool pure, const Lane* lanes, size_t count, float* out, size_t n,
+                            std::vector<float>& stack, Faults faults) const {
+        if (!pure) {
+            if (stack.size() < depth) {
+                stack.resize(depth);
+            }
+            // set() rather than a plain write, so memoized integ bodies
+            // reading these variables see them change.
+            for (size_t i = 0; i < n; ++i) {
+                for (size_t l = 0; l < count; ++l) {
+                    lanes[l].slot->set(lanes[l].values[i]);
+                }
+                exec(begin, end, stack.data(), faults);
+                out[i] = stack[0];
+            }
+            return;
+        }
+
+        if (stack.size() < depth * LANES) {
+            stack.resize(depth * LANES);
+        }
+
+        // Each stack entry is a row of LANES values.
+        for (size_t base = 0; base < n; base += LANES) {
+            size_t m = std::min(LANES, n - base);
+            float* sp = stack.data();
+
+            for (size_t pc = begin; pc < end; ++pc) {
+                const Instr& in = code[pc];
+                switch (in.op) {
+                    case OP_CONST: std::fill(sp, sp + m, in.val); sp += LANES; continue;
+                    case OP_LOAD: {
+                        const Lane* lane = std::find_if(lanes, lanes + count, [&](const Lane& l) { return l.slot == slots[in.arg]; });
+                        if (lane != lanes + count) {
+                            std::copy(lane->values + base, lane->values + base + m, sp);
+                        } else {
+                            std::fill(sp, sp + m, slots[in.arg]->value);
+                        }
+                        sp += LANES;
+                    } continue;
+                    case OP_UNDECLARED: throw names[in.arg] + " not declared";
+                    default: break;
+                }
+
+                // The top row, and for binary operators the row under it.
+                float* a = sp - LANES;
+                float* b = sp;
+
+                switch (in.op) {
+                    case OP_NEG: for (size_t k = 0; k < m; ++k) a[k] = -a[k]; break;
+                    case OP_SIN: for (size_t k = 0; k < m; ++k) a[k] = std::sin(a[k]); break;
+                    case OP_COS: for (size_t k = 0; k < m; ++k) a[k] = std::cos(a[k]); break;
+                    case OP_TAN: for (size_t k = 0; k < m; ++k) a[k] = std::tan(a[k]); break;
+                    case OP_COSEC: for (size_t k = 0; k < m; ++k) a[k] = 1.0f / std::sin(a[k]); break;
+                    case OP_SEC: for (size_t k = 0; k < m; ++k) a[k] = 1.0f / std::cos(a[k]); break;
+                    case OP_COT: for (size_t k = 0; k < m; ++k) a[k] = 1.0f / std::tan(a[k]); break;
+                    case OP_LOG: for (size_t k = 0; k < m; ++k) a[k] = std::log(a[k]); break;
+                    case OP_ABS: for (size_t k = 0; k < m; ++k) a[k] = std::abs(a[k]); break;
+
+                    case OP_ADD: a -= LANES; b -= LANES; for (size_t k = 0; k < m; ++k) a[k] = a[k] + b[k]; sp -= LANES; break;
+                    case OP_SUB: a -= LANES; b -= LANES; for (size_t k = 0; k < m; ++k) a[k] = a[k] - b[k]; sp -= LANES; break;
+                    case OP_MUL: a -= LANES; b -= LANES; for (size_t k = 0; k < m; ++k) a[k] = a[k] * b[k]; sp -= LANES; break;
+                    case OP_DIV: {
+                        a -= LANES; b -= LANES;
+                        if (faults == Faults::THROW && std::find(b, b + m, 0.0f) != b + m) {
+                            throw std::runtime_error("Error: Division by zero");
+                        }
+                        for (size_t k = 0; k < m; ++k) a[k] = a[k] / b[k];
+                        sp -= LANES;
+                    } break;
+                    case OP_POW: {
+                        a -= LANES; b -= LANES;
+                        for (size_t k = 0; k < m; ++k) {
+                            if (faults == Faults::THROW && a[k] < 0 && b[k] != std::floor(b[k])) {
+                                throw std::runtime_error("Error: Negative base to non-integer power");
+                            }
+                            a[k] = std::pow(a[k], b[k]);
+                        }
+                        sp -= LANES;
+                    } break;
+
+                    default: break;
+                }
+            }
+
+            std::copy(stack.data(), stack.data() + m, out + base);
+        }
+    }
+
+    namespace {
+
+        using Interval = Program::Interval;
+
+        constexpr float INF = std::numeric_limits<float>::infinity();
+        constexpr float PI = 3.14159265358979323846f;
+        constexpr Interval ENTIRE{ -INF, INF };
+
+        Interval hull(float a, float b, float c, float d) {
+            Interval r{ std::min(std::min(a, b), std::min(c, d)), std::max(std::max(a, b), std::max(c, d)) };
+            return std::isnan(r.lo) || std::isnan(r.hi) ? ENTIRE : r;
+        }
+
+        bool contains(Interval a, float v) {
+            return a.lo <= v && v <= a.hi;
+        }
+
+        // sin over [lo, hi], using where its peaks and troughs fall.
+        Interval sine(Interval a) {
+            if (!(a.hi - a.lo < 2 * PI)) return { -1, 1 };
+            float s = std::sin(a.lo);
+            float e = std::sin(a.hi);
+            Interval r{ std::min(s, e), std::max(s, e) };
+            // The first peak (pi/2 + 2k pi) and trough (3pi/2 + 2k pi) at or after lo.
+            float peak = PI / 2 + 2 * PI * std::ceil((a.lo - PI / 2) / (2 * PI));
+            float trough = 3 * PI / 2 + 2 * PI * std::ceil((a.lo - 3 * PI / 2) / (2 * PI));
+            if (peak <= a.hi) r.hi = 1;
+            if (trough <= a.hi) r.lo = -1;
+            return r;
+        }
+
+        Interval power(Interval a, Interval b) {
+            if (b.lo == b.hi && b.lo == std::floor(b.lo)) {
+                float n = b.lo;
+                bool zero = contains(a, 0);
+                if (n < 0 && zero) return ENTIRE;
+                float p = std::pow(a.lo, n);
+                float q = std::pow(a.hi, n);
+                if (zero && std::fmod(n, 2.0f) == 0 && n > 0) {
+                    return { 0, std::max(p, q) };
+                }
+                return hull(p, q, p, q);
+            }
+            if (a.lo > 0) {
+                return hull(std::pow(a.lo, b.lo), std::pow(a.lo, b.hi), std::pow(a.hi, b.lo), std::pow(a.hi, b.hi));
+            }
+            return ENTIRE;
+        }
+    }
+
+    Interval Program::bounds(const Range* ranges, size_t count, std::vector<Interval>& stack) const {
+        if (stack.size() < depth) {
+            stack.resize(depth);
+        }
+        Interval* sp = stack.data();
+
+        for (size_t pc = 0; pc < code.size(); ++pc) {
+            const Instr& in = code[pc];
+
+            switch (in.op) {
+                case OP_CONST: *sp++ = { in.val, in.val }; break;
+                case OP_LOAD: {
+                    const Range* range = std::find_if(ranges, ranges + count, [&](const Range& r) { return r.slot == slots[in.arg]; });
+                    float v = slots[in.arg]->value;
+                    *sp++ = range != ranges + count ? range->bounds : Interval{ v, v };
+                } break;
+                case OP_UNDECLARED: throw names[in.arg] + " not declared";
+
+                case OP_NEG: sp[-1] = { -sp[-1].hi, -sp[-1].lo }; break;
+                case OP_SIN: sp[-1] = sine(sp[-1]); break;
+                case OP_COS: sp[-1] = sine({ sp[-1].lo + PI / 2, sp[-1].hi + PI / 2 }); break;
+                case OP_TAN:
+                case OP_COSEC:
+                case OP_SEC:
+                case OP_COT: sp[-1] = ENTIRE; break;
+                case OP_LOG: sp[-1] = sp[-1].lo > 0 ? Interval{ std::log(sp[-1].lo), std::log(sp[-1].hi) } : ENTIRE; break;
+                case OP_ABS: {
+                    Interval a = sp[-1];
+                    float l = std::abs(a.lo);
+                    float h = std::abs(a.hi);
+                    sp[-1] = contains(a, 0) ? Interval{ 0, std::max(l, h) } : Interval{ std::min(l, h), std::max(l, h) };
+                } break;
+
+                case OP_ADD: --sp; sp[-1] = hull(sp[-1].lo + sp[0].lo, sp[-1].hi + sp[0].hi, sp[-1].lo + sp[0].lo, sp[-1].hi + sp[0].hi); break;
+                case OP_SUB: --sp; sp[-1] = hull(sp[-1].lo - sp[0].hi, sp[-1].hi - sp[0].lo, sp[-1].lo - sp[0].hi, sp[-1].hi - sp[0].lo); break;
+                case OP_MUL: {
+                    --sp;
+                    Interval l = sp[-1], r = sp[0];
+                    sp[-1] = hull(l.lo * r.lo, l.lo * r.hi, l.hi * r.lo, l.hi * r.hi);
+                } break;
+                case OP_DIV: {
+                    --sp;
+                    Interval l = sp[-1], r = sp[0];
+                    sp[-1] = contains(r, 0) ? ENTIRE : hull(l.lo / r.lo, l.lo / r.hi, l.hi / r.lo, l.hi / r.hi);
+                } break;
+                case OP_POW: --sp; sp[-1] = power(sp[-1], sp[0]); break;
+
+                case OP_SKIP: pc += in.arg; break;
+                case OP_INTEG: --sp; sp[-1] = ENTIRE; break;
+                case OP_MULTI_INTEG: sp -= 2 * integrals[in.arg].vars.size() - 1; sp[-1] = ENTIRE; break;
+            }
+        }
+        return stack[0];
+    }
+
+    // `sp` points one past the top of the value stack.
+    float* Program::exec(size_t begin, size_t end, float* sp, Faults faults) const {
+        for (size_t pc = begin; pc < end; ++pc) {
+            const Instr& in = code[pc];
+
+            switch (in.op) {
+                case OP_CONST: *sp++ = in.val; break;
+                case OP_LOAD: *sp++ = slots[in.arg]->value; break;
+                case OP_UNDECLARED: throw names[in.arg] + " not declared";
+
+                case OP_NEG: sp[-1] = -sp[-1]; break;
+                case OP_SIN: sp[-1] = std::sin(sp[-1]); break;
+                case OP_COS: sp[-1] = std::cos(sp[-1]); break;
+                case OP_TAN: sp[-1] = std::tan(sp[-1]); break;
+                case OP_COSEC: sp[-1] = 1.0f / std::sin(sp[-1]); break;
+                case OP_SEC: sp[-1] = 1.0f / std::cos(sp[-1]); break;
+                case OP_COT: sp[-1] = 1.0f / std::tan(sp[-1]); break;
+                case OP_LOG: sp[-1] = std::log(sp[-1]); break;
+                case OP_ABS: sp[-1] = std::abs(sp[-1]); break;
+
+                case OP_ADD: --sp; sp[-1] = sp[-1] + sp[0]; break;
+                case OP_SUB: --sp; sp[-1] = sp[-1] - sp[0]; break;
+                case OP_MUL: --sp; sp[-1] = sp[-1] * sp[0]; break;
+                case OP_DIV: {
+                    --sp;
+                    if (faults == Faults::THROW && sp[0] == 0) {
+                        throw std::runtime_error("Error: Division by zero");
+                    }
+                    sp[-1] = sp[-1] / sp[0];
+                } break;
+                case OP_POW: {
+                    --sp;
+                    float left = sp[-1];
+                    float right = sp[0];
+                    if (faults == Faults::THROW && left < 0 && right != std::floor(right)) {
+                        throw std::runtime_error("Error: Negative base to non-integer power");
+                    }
+                    sp[-1] = std::pow(left, right);
+                } break;
+
+                case OP_SKIP: pc += in.arg; break;
+                case OP_INTEG: {
+                    const Integral& integral = integrals[in.arg];
+
+                    float limit_end = *--sp;
+                    float limit_start = *--sp;
+
+                    int n = 100000;
+
+                    float h = (limit_end - limit_start) / n;
+
+                    std::vector<uint64_t> key;
+                    if (memo != nullptr) {
+                        key.push_back(integral.shape);
+                        key.push_back(std::bit_cast<uint32_t>(limit_start));
+                        key.push_back(std::bit_cast<uint32_t>(limit_end));
+                        for (const Environment::Slot* dep : integral.deps) {
+                            key.push_back(dep->version);
+                        }
+
+                        if (const std::vector<float>* hit = memo->find(key)) {
+                            x->set(limit_start + n * h);
+                            *sp++ = hit->front();
+                            break;
+                        }
+                    }
+
+                    float result = 0.0f;
+                    bool reporting = progress != nullptr && progress->claim(n);
+
+                    for (int i = 1; i <= n; ++i) {
+                        if (i % YIELD == 0 && progress != nullptr) {
+                            if (progress->cancelled()) {
+                                x->set(x->value);
+                                progress->check();
+                            }
+                            if (reporting) progress->advance(YIELD);
+                        }
+                        x->value = limit_start + i * h;
+                        result += *(exec(integral.body, integral.body_end, sp, faults) - 1);
+                    }
+                    x->set(x->value);
+
+                    *sp++ = result * h;
+
+                    if (memo != nullptr) {
+                        memo->insert(key, { result * h });
+                    }
+                } break;
+                case OP_MULTI_INTEG: {
+                    const Integral& integral = integrals[in.arg];
+                    size_t count = 2 * integral.vars.size();
+                    sp -= count;
+                    double limits[2 * Cubature::MAX_DIMENSIONS];
+                    std::copy(sp, sp + count, limits);
+                    *sp++ = integrate(integral, limits);
+                } break;
+            }
+        }
+        return sp;
+    }
+
+    DD Program::runDD(std::vector<DD>& stack) const {
+        if (stack.size() < depth) {
+            stack.resize(depth);
+        }
+        execDD(0, code.size(), stack.data());
+        return stack[0];
+    }
+
+    // exec() in double-double; the errors are the same.
+    DD* Program::execDD(size_t begin, size_t end, DD* sp) const {
+        for (size_t pc = begin; pc < end; ++pc) {
+            const Instr& in = code[pc];
+
+            switch (in.op) {
+                case OP_CONST: *sp++ = constants[in.arg]; break;
+                case OP_LOAD: *sp++ = slots[in.arg]->exact; break;
+                case OP_UNDECLARED: throw names[in.arg] + " not declared";
+
+                case OP_NEG: sp[-1] = -sp[-1]; break;
+                case OP_SIN: sp[-1] = sin(sp[-1]); break;
+                case OP_COS: sp[-1] = cos(sp[-1]); break;
+                case OP_TAN: sp[-1] = tan(sp[-1]); break;
+                case OP_COSEC: sp[-1] = DD(1) / sin(sp[-1]); break;
+                case OP_SEC: sp[-1] = DD(1) / cos(sp[-1]); break;
+                case OP_COT: sp[-1] = DD(1) / tan(sp[-1]); break;
+                case OP_LOG: sp[-1] = log(sp[-1]); break;
+                case OP_ABS: sp[-1] = abs(sp[-1]); break;
+
+                case OP_ADD: --sp; sp[-1] = sp[-1] + sp[0]; break;
+                case OP_SUB: --sp; sp[-1] = sp[-1] - sp[0]; break;
+                case OP_MUL: --sp; sp[-1] = sp[-1] * sp[0]; break;
+                case OP_DIV: {
+                    --sp;
+                    if (sp[0].hi == 0) {
+                        throw std::runtime_error("Error: Division by zero");
+                    }
+                    sp[-1] = sp[-1] / sp[0];
+                } break;
+                case OP_POW: {
+                    --sp;
+                    if (sp[-1].hi < 0 && sp[0] != floor(sp[0])) {
+                        throw std::runtime_error("Error: Negative base to non-integer power");
+                    }
+                    sp[-1] = pow(sp[-1], sp[0]);
+                } break;
+
+                case OP_SKIP: pc += in.arg; break;
+                case OP_INTEG: {
+                    const Integral& integral = integrals[in.arg];
+
+                    DD limit_end = *--sp;
+                    DD limit_start = *--sp;
+
+                    int n = 100000;
+                    DD h = (limit_end - limit_start) / DD(n);
+                    DD result;
+                    bool reporting = progress != nullptr && progress->claim(n);
+
+                    for (int i = 1; i <= n; ++i) {
+                        if (i % YIELD == 0 && progress != nullptr) {
+                            progress->check();
+                            if (reporting) progress->advance(YIELD);
+                        }
+                        x->set(limit_start + h * static_cast<double>(i));
+                        result += *(execDD(integral.body, integral.body_end, sp) - 1);
+                    }
+
+                    *sp++ = result * h;
+                } break;
+                case OP_MULTI_INTEG: {
+                    const Integral& integral = integrals[in.arg];
+                    size_t count = 2 * integral.vars.size();
+                    sp -= count;
+                    double limits[2 * Cubature::MAX_DIMENSIONS];
+                    for (size_t i = 0; i < count; ++i) {
+                        limits[i] = sp[i].hi;
+                    }
+                    *sp++ = DD(integrate(integral, limits));
+                } break;
+            }
+        }
+        return sp;
+    }
+
+    float Program::integrate(const Integral& integral, const double* limits) const {
+        size_t dims = integral.vars.size();
+        double lower[Cubature::MAX_DIMENSIONS];
+        double upper[Cubature::MAX_DIMENSIONS];
+        for (size_t d = 0; d < dims; ++d) {
+            lower[d] = limits[2 * d];
+            upper[d] = limits[2 * d + 1];
+        }
+
+        // The variables are left at their upper limits, as integ leaves x.
+        auto finish = [&](float value, float error) {
+            for (size_t d = 0; d < dims; ++d) {
+                integral.vars[d]->set(static_cast<float>(upper[d]));
+            }
+            err->set(error);
+            return value;
+        };
+
+        std::vector<uint64_t> key;
+        if (memo != nullptr) {
+            key.push_back(integral.shape);
+            for (size_t i = 0; i < 2 * dims; ++i) {
+                key.push_back(std::bit_cast<uint32_t>(static_cast<float>(limits[i])));
+            }
+            for (const Environment::Slot* var : integral.vars) {
+                key.push_back(reinterpret_cast<uintptr_t>(var));
+            }
+            // Values as well as versions: an enclosing integ over x steps
+            // x without a new version.
+            for (const Environment::Slot* dep : integral.deps) {
+                key.push_back(dep->version);
+                key.push_back(std::bit_cast<uint32_t>(dep->value));
+            }
+
+            if (const std::vector<float>* hit = memo->find(key)) {
+                return finish((*hit)[0], (*hit)[1]);
+            }
+        }
+
+        auto f = [this, &integral](const float* const* points, size_t n, float* out, std::vector<float>& stack) {
+            Lane lanes[Cubature::MAX_DIMENSIONS];
+            for (size_t d = 0; d < integral.vars.size(); ++d) {
+                lanes[d] = { integral.vars[d], points[d] };
+            }
+            execBatch(integral.body, integral.body_end, integral.pure, lanes, integral.vars.size(), out, n, stack);
+        };
+
+        Cubature::Result result = Cubature::integrate(f, lower, upper, dims, integral.pure ? resolveWorkers(workers) : 1, progress);
+        float value = static_cast<float>(result.value);
+        float error = static_cast<float>(result.error);
+        if (memo != nullptr) {
+            memo->insert(key, { value, error });
+        }
+        return finish(value, error);
+    }
+
+    void Program::key(std::vector<uint64_t>& out, const Environment::Slot* bound) const {
+        out.push_back(shape());
+        for (const Environment::Slot* slot : slots) {
+            if (slot != bound) {
+                out.push_back(slot->version);
+            }
+        }
+    }
+
+    // Hashes the instructions in [begin, end). The code is the tree in
+    // post-order, so equal hashes mean equal expression structure.
+    uint64_t Program::hash(size_t begin, size_t end) const {
+        uint64_t h = 0xcbf29ce484222325ull;
+        auto mix = [&h](uint64_t word) {
+            h = (h ^ word) * 0x100000001b3ull;
+            h ^= h >> 29;
+        };
+
+        for (size_t pc = begin; pc < end; ++pc) {
+            const Instr& in = code[pc];
+            mix(in.op);
+            switch (in.op) {
+                case OP_CONST: mix(std::bit_cast<uint32_t>(in.val)); break;
+                case OP_LOAD: mix(reinterpret_cast<uintptr_t>(slots[in.arg])); break;
+                case OP_UNDECLARED: {
+                    for (char c : names[in.arg]) mix(static_cast<unsigned char>(c));
+                } break;
+                case OP_SKIP: mix(in.arg); break;
+                case OP_INTEG: mix(integrals[in.arg].body_end - integrals[in.arg].body); break;
+                case OP_MULTI_INTEG: {
+                    mix(integrals[in.arg].body_end - integrals[in.arg].body);
+                    for (const Environment::Slot* var : integrals[in.arg].vars) {
+                        mix(reinterpret_cast<uintptr_t>(var));
+                    }
+                } break;
+                default: break;
+            }
+        }
+        return h;
+    }
+}
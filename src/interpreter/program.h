@@ -0,0 +1,205 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../parser/expr.h"
+#include "../environment/environment.h"
+#include "memo.h"
+#include "progress.h"
+
+namespace Acalc {
+
+    // An expression lowered to post-order instructions, evaluated with an
+    // explicit value stack. Variables are resolved to their Environment
+    // slots when compiling, so evaluating in a loop (graph, integ) does no
+    // name lookups. Neither compiling nor running recurses on the depth of
+    // the expression; only nested integ bodies re-enter exec().
+    //
+    // When compiled with a MemoCache, each integ looks its result up by the
+    // structural hash of its body, its limits and the versions of the
+    // variables the body reads (other than x, which integ binds itself).
+    // When compiled with a Progress, integ polls it every YIELD steps.
+    //
+    // integ over named variables is handed to Cubature, and sets `err` to
+    // its error estimate. A body without integ of its own is evaluated in
+    // batches, on the Compiler's `workers` threads (0 for one per core).
+    class Program {
+        public:
+            enum OpCode : uint8_t {
+                OP_CONST, OP_LOAD, OP_UNDECLARED,
+
+                OP_NEG, OP_SIN, OP_COS, OP_TAN,
+                OP_COSEC, OP_SEC, OP_COT, OP_LOG, OP_ABS,
+
+                OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_POW,
+
+                // Jumps over the `arg` instructions of an integ body, which
+                // run only when the matching OP_INTEG executes them.
+                OP_SKIP,
+                // Pops the limits and integrates the body described by
+                // integrals[arg].
+                OP_INTEG,
+                // Pops a lower and an upper limit for each of
+                // integrals[arg].vars and integrates the body over them.
+                OP_MULTI_INTEG
+            };
+
+            struct Instr {
+                OpCode op;
+                uint32_t arg;
+                float val;
+            };
+
+            // What a division by zero or a negative base to a non-integer
+            // power does. THROW reports it, as run() does. QUIET leaves the
+            // IEEE result (an infinity or NaN) in that entry alone, for
+            // sampling curves that are undefined at some points.
+            enum class Faults : uint8_t { THROW, QUIET };
+
+            // A variable taking one value per batch entry.
+            struct Lane {
+                Environment::Slot* slot;
+                const float* values;
+            };
+
+            struct Interval {
+                float lo;
+                float hi;
+            };
+
+            // A variable ranging over an interval.
+            struct Range {
+                const Environment::Slot* slot;
+                Interval bounds;
+            };
+
+            // `stack` is scratch space; it is grown to the program's depth.
+            float run(std::vector<float>& stack) const;
+
+            // Evaluates the program in double-double arithmetic, from the
+            // literals' digits and the variables' exact values. integ is
+            // not memoized here, and integ over named variables evaluates
+            // its body in float.
+            DD runDD(std::vector<DD>& stack) const;
+
+            // Evaluates the program once for each of the `n` values in
+            // `params`, with `param` taking each value in turn, into `out`.
+            // Each instruction is applied to a whole batch of values before
+            // the next, which pays the dispatch once per batch and lets the
+            // inner loops vectorize. Programs containing integ fall back to
+            // one run() per value. integ over named variables always throws.
+            void runBatch(Environment::Slot* param, const float* params, float* out, size_t n, std::vector<float>& stack,
+                          Faults faults = Faults::THROW) const;
+
+            // As above with several variables varying together. The lane
+            // variables are left untouched unless the program contains
+            // integ, so a program without integ may run batches on several
+            // threads at once.
+            void runBatch(const Lane* lanes, size_t count, float* out, size_t n, std::vector<float>& stack,
+                          Faults faults = Faults::THROW) const;
+
+            // Bounds the program's value while each variable in `ranges`
+            // varies over its interval, using interval arithmetic. The bounds
+            // are conservative: operations that cannot be bounded cheaply
+            // (tan, integ, division by an interval holding 0) give the whole
+            // real line.
+            Interval bounds(const Range* ranges, size_t count, std::vector<Interval>& stack) const;
+
+            // Whether batches are free of side effects; see runBatch.
+            bool pure() const { return integrals.empty(); }
+
+            // Appends the structural hash of the whole program and the
+            // versions of every variable it reads, except `bound`.
+            void key(std::vector<uint64_t>& out, const Environment::Slot* bound) const;
+
+            // Structural hash of the whole program.
+            uint64_t shape() const { return hash(0, code.size()); }
+
+            // Every variable the program reads, once per occurrence.
+            const std::vector<Environment::Slot*>& reads() const { return slots; }
+
+        private:
+            static constexpr size_t LANES = 256;
+            static constexpr int YIELD = 1024;
+
+            struct Integral {
+                size_t body;
+                size_t body_end;
+                uint64_t shape;
+                std::vector<Environment::Slot*> deps;
+                // The named variables, for OP_MULTI_INTEG.
+                std::vector<Environment::Slot*> vars;
+                // Whether the body holds no integ of its own.
+                bool pure;
+            };
+
+            float* exec(size_t begin, size_t end, float* sp, Faults faults = Faults::THROW) const;
+            void execBatch(size_t begin, size_t end, bool pure, const Lane* lanes, size_t count, float* out, size_t n,
+                           std::vector<float>& stack, Faults faults = Faults::THROW) const;
+            // `limits` holds a lower and an upper limit per variable.
+            float integrate(const Integral& integral, const double* limits) const;
+            DD* execDD(size_t begin, size_t end, DD* sp) const;
+            uint64_t hash(size_t begin, size_t end) const;
+
+        private:
+            std::vector<Instr> code;
+            // Literals for runDD, indexed by the OP_CONST's arg.
+            std::vector<DD> constants;
+            std::vector<Environment::Slot*> slots;
+            std::vector<std::string> names;
+            std::vector<Integral> integrals;
+            Environment::Slot* x = nullptr;
+            Environment::Slot* err = nullptr;
+            MemoCache* memo = nullptr;
+            Progress* progress = nullptr;
+            size_t workers = 0;
+            size_t depth = 0;
+
+            friend class Compiler;
+    };
+
+    // Lowers an expression with an explicit work list. Expanding a node
+    // schedules its operands followed by the instruction that combines them;
+    // leaves are emitted as soon as they are reached. An integ body is
+    // bracketed by an OP_SKIP so that only its OP_INTEG executes it. The work
+    // lists are kept between calls, so compiling allocates nothing once warm.
+    class Compiler : public ExprVisitor {
+        public:
+            Compiler(Environment& env, MemoCache* memo = nullptr, Progress* progress = nullptr, size_t workers = 0)
+            : env{env}, memo{memo}, progress{progress}, workers{workers} {}
+
+            // Replaces the contents of `out` with the lowered `expr`.
+            void compile(Expr* expr, Program& out);
+
+        private:
+            enum Step { EXPAND, EMIT, OPEN_BODY, CLOSE_BODY, EMIT_INTEG };
+
+            struct Task {
+                Expr* node;
+                Step step;
+                // The instruction to EMIT, or which integ a CLOSE_BODY ends.
+                Program::OpCode op = Program::OP_CONST;
+            };
+
+            void emit(Program::OpCode op, uint32_t arg = 0, float val = 0);
+
+            float visitLiteralExpr(LiteralExpr* expr) override;
+            float visitIdentifierExpr(IdentifierExpr* expr) override;
+            float visitUnaryExpr(UnaryExpr* expr) override;
+            float visitBinaryExpr(BinaryExpr* expr) override;
+            float visitIntegExpr(IntegExpr* expr) override;
+            float visitMultiIntegExpr(MultiIntegExpr* expr) override;
+
+        private:
+            Environment& env;
+            MemoCache* memo;
+            Progress* progress;
+            size_t workers;
+            Program* program = nullptr;
+            size_t height = 0;
+            std::vector<Task> tasks;
+            std::vector<size_t> bodies;
+            std::vector<size_t> closed;
+    };
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+
+namespace Acalc {
+
+    // How far the running statement has got, and whether it has been asked
+    // to stop. Long loops (integ steps, graph samples, sampler levels and
+    // contour tiles) poll it at yield points and unwind with an error once
+    // it is cancelled, leaving the session's variables as they were.
+    //
+    // cancel(), cancelled() and fraction() may be called from any thread,
+    // and cancel() from a signal handler; the rest belong to the thread
+    // running the statement.
+    class Progress {
+        public:
+            void cancel() { stop.store(true, std::memory_order_relaxed); }
+            bool cancelled() const { return stop.load(std::memory_order_relaxed); }
+
+            // Forgets an earlier cancel() before new work is started.
+            void reset() {
+                stop.store(false, std::memory_order_relaxed);
+                begin();
+            }
+
+            // Starts a statement with nothing done.
+            void begin() {
+                done.store(0, std::memory_order_relaxed);
+                total.store(0, std::memory_order_relaxed);
+            }
+
+            // The first loop of a statement to claim it reports the fraction
+            // done; loops nested in it only poll. Returns whether `units` of
+            // work were claimed. A loop that starts after the claimed one
+            // has finished takes over.
+            bool claim(uint64_t units) {
+                uint64_t t = total.load(std::memory_order_relaxed);
+                if (t != 0 && done.load(std::memory_order_relaxed) < t) return false;
+                done.store(0, std::memory_order_relaxed);
+                total.store(units, std::memory_order_relaxed);
+                return true;
+            }
+
+            void advance(uint64_t units) { done.fetch_add(units, std::memory_order_relaxed); }
+
+            // A yield point.
+            void check() const {
+                if (cancelled()) {
+                    throw std::runtime_error("Error: cancelled");
+                }
+            }
+
+            // In [0, 1], or negative while no loop has claimed the statement.
+            float fraction() const {
+                uint64_t t = total.load(std::memory_order_relaxed);
+                if (t == 0) return -1;
+                uint64_t d = done.load(std::memory_order_relaxed);
+                return d >= t ? 1.0f : static_cast<float>(d) / t;
+            }
+
+        private:
+            std::atomic<bool> stop{ false };
+            std::atomic<uint64_t> done{ 0 };
+            std::atomic<uint64_t> total{ 0 };
+    };
+}
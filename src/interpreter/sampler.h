@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include "../canvas/canvas.h"
+
+namespace Acalc {
+
+    // Adaptive sampling of a parametric curve in screen space. A uniform
+    // first pass is refined one level at a time: every segment longer than
+    // MAX_LENGTH pixels, or meeting a neighbour at a sharper angle than
+    // MAX_TURN, is bisected, and the new parameter values of a level are
+    // evaluated as one batch. Segments lying wholly off screen are left
+    // alone. The result is split into polylines at points that are not
+    // finite and at segments still longer than BREAK once refinement stops,
+    // which is where the curve jumps.
+    class Sampler {
+        public:
+            static constexpr size_t INITIAL = 1024;
+            static constexpr int LEVELS = 16;
+            static constexpr size_t LIMIT = size_t(1) << 21;
+            static constexpr float MAX_LENGTH = 2.0f;
+            static constexpr float MIN_LENGTH = 0.5f;
+            static constexpr float MAX_TURN = 0.985f; // cosine of about 10 degrees
+            static constexpr float BREAK = 64.0f;
+            static constexpr float WIDTH = 800;
+            static constexpr float HEIGHT = 600;
+            static constexpr float MARGIN = 100;
+
+            // `map(params, points)` fills points[i] with the screen position
+            // of the curve at params[i]; `points` is already sized.
+            template <typename Map>
+            void trace(float t0, float t1, Map&& map, std::vector<std::vector<Point>>& out) {
+                ts.clear();
+                for (size_t i = 0; i <= INITIAL; ++i) {
+                    ts.push_back(t0 + (t1 - t0) * i / INITIAL);
+                }
+                pts.resize(ts.size());
+                map(ts, pts);
+
+                for (int level = 0; level < LEVELS; ++level) {
+                    mids.clear();
+                    split.assign(ts.size() - 1, 0);
+                    for (size_t i = 0; i + 1 < ts.size(); ++i) {
+                        if (refine(i)) {
+                            split[i] = 1;
+                            mids.push_back(ts[i] + (ts[i + 1] - ts[i]) / 2);
+                        }
+                    }
+                    if (mids.empty() || ts.size() + mids.size() > LIMIT) break;
+
+                    midPts.resize(mids.size());
+                    map(mids, midPts);
+
+                    nextTs.clear();
+                    nextPts.clear();
+                    size_t k = 0;
+                    for (size_t i = 0; i < ts.size(); ++i) {
+                        nextTs.push_back(ts[i]);
+                        nextPts.push_back(pts[i]);
+                        if (i < split.size() && split[i]) {
+                            nextTs.push_back(mids[k]);
+                            nextPts.push_back(midPts[k++]);
+                        }
+                    }
+                    ts.swap(nextTs);
+                    pts.swap(nextPts);
+                }
+
+                emit(out);
+            }
+
+        private:
+            static bool finite(const Point& p) {
+                return std::isfinite(p.x) && std::isfinite(p.y);
+            }
+
+            static float length(const Point& a, const Point& b) {
+                return std::hypot(b.x - a.x, b.y - a.y);
+            }
+
+            static bool offscreen(const Point& a, const Point& b) {
+                return (a.x < -MARGIN && b.x < -MARGIN) || (a.x > WIDTH + MARGIN && b.x > WIDTH + MARGIN)
+                    || (a.y < -MARGIN && b.y < -MARGIN) || (a.y > HEIGHT + MARGIN && b.y > HEIGHT + MARGIN);
+            }
+
+            // Whether the curve turns sharply at point `i`.
+            bool sharp(size_t i) const {
+                if (i == 0 || i + 1 >= pts.size()) return false;
+                const Point& a = pts[i - 1];
+                const Point& b = pts[i];
+                const Point& c = pts[i + 1];
+                if (!finite(a) || !finite(c)) return false;
+
+                float ux = b.x - a.x, uy = b.y - a.y;
+                float vx = c.x - b.x, vy = c.y - b.y;
+                float norms = std::hypot(ux, uy) * std::hypot(vx, vy);
+                return norms > 0 && (ux * vx + uy * vy) < MAX_TURN * norms;
+            }
+
+            bool refine(size_t i) const {
+                const Point& a = pts[i];
+                const Point& b = pts[i + 1];
+                bool fa = finite(a);
+                bool fb = finite(b);
+
+                // Narrow down where the curve stops being defined.
+                if (fa != fb) return true;
+                if (!fa || offscreen(a, b)) return false;
+
+                float len = length(a, b);
+                return len > MAX_LENGTH || (len > MIN_LENGTH && (sharp(i) || sharp(i + 1)));
+            }
+
+            void emit(std::vector<std::vector<Point>>& out) const {
+                std::vector<Point> line;
+                auto finish = [&out, &line]() {
+                    // A lone point left behind by an off-screen stretch is
+                    // not worth drawing.
+                    if (line.size() > 1 || (line.size() == 1 && !offscreen(line[0], line[0]))) {
+                        out.push_back(std::move(line));
+                    }
+                    line.clear();
+                };
+
+                for (size_t i = 0; i < pts.size(); ++i) {
+                    const Point& p = pts[i];
+                    if (!finite(p)) {
+                        finish();
+                        continue;
+                    }
+                    if (!line.empty()) {
+                        const Point& prev = line.back();
+                        if (length(prev, p) > BREAK || offscreen(prev, p)) {
+                            finish();
+                        }
+                    }
+                    line.push_back(p);
+                }
+                finish();
+            }
+
+        private:
+            std::vector<float> ts, nextTs, mids;
+            std::vector<Point> pts, nextPts, midPts;
+            std::vector<char> split;
+    };
+}
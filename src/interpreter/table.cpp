@@ -0,0 +1,176 @@
+#include "table.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <exception>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include "workers.h"
+
+namespace Acalc {
+
+    namespace {
+
+        // The shortest text for a float has at most 9 significant digits,
+        // so it is at most 15 characters, as in "-1.23456789e-38"; a row is
+        // two of them, a comma and a newline.
+        constexpr size_t ROW = 2 * 15 + 2;
+
+        // One block of rows, with its own scratch space so that workers
+        // share nothing but the program.
+        struct Block {
+            std::vector<float> xs;
+            std::vector<float> values;
+            std::vector<float> stack;
+            std::vector<char> text;
+            size_t size = 0;
+            std::exception_ptr error;
+        };
+
+        // Writes v and the separator after it, leaving p at the end.
+        char* put(char* p, char* end, float v, char separator) {
+            auto [next, ec] = std::to_chars(p, end - 1, v);
+            if (ec != std::errc()) {
+                throw std::runtime_error("Error: table row does not fit its buffer");
+            }
+            *next = separator;
+            return next + 1;
+        }
+
+        float at(double start, double step, uint64_t i) {
+            return static_cast<float>(start + static_cast<double>(i) * step);
+        }
+
+        void fill(const Program& f, Environment::Slot* x, double start, double step, uint64_t first, size_t n,
+                  Block& block) {
+            block.xs.resize(n);
+            block.values.resize(n);
+            for (size_t i = 0; i < n; ++i) {
+                block.xs[i] = at(start, step, first + i);
+            }
+            Program::Lane lane{ x, block.xs.data() };
+            f.runBatch(&lane, 1, block.values.data(), n, block.stack);
+
+            block.text.resize(n * ROW);
+            char* p = block.text.data();
+            char* end = p + block.text.size();
+            for (size_t i = 0; i < n; ++i) {
+                p = put(p, end, block.xs[i], ',');
+                p = put(p, end, block.values[i], '\n');
+            }
+            block.size = static_cast<size_t>(p - block.text.data());
+        }
+    }
+
+    uint64_t Table::rows(double start, double end, double step) {
+        if (!std::isfinite(start) || !std::isfinite(end) || !std::isfinite(step)) {
+            throw std::runtime_error("Error: table range must be finite");
+        }
+        if (step == 0) {
+            throw std::runtime_error("Error: table step must not be 0");
+        }
+
+        double span = (end - start) / step;
+        if (span < 0) return 0;
+        if (span >= static_cast<double>(MAX_ROWS)) {
+            throw std::runtime_error("Error: table has too many rows");
+        }
+
+        // The division can land either side of a whole number of steps,
+        // so the last row is settled by comparing the rows as floats.
+        // Rounding moves it by one step at most.
+        auto beyond = [&](uint64_t i) {
+            float v = at(start, step, i);
+            return step > 0 ? v > static_cast<float>(end) : v < static_cast<float>(end);
+        };
+        uint64_t last = static_cast<uint64_t>(span);
+        if (last > 0 && beyond(last)) {
+            --last;
+        } else if (!beyond(last + 1)) {
+            ++last;
+        }
+        return last + 1;
+    }
+
+    void Table::write(const Program& f, Environment::Slot* x, double start, double step, uint64_t rows,
+                      std::ostream& out, Progress* progress, size_t workers) {
+        if (rows == 0) return;
+
+        uint64_t blocks = (rows + BLOCK - 1) / BLOCK;
+        Progress* reporting = progress != nullptr && progress->claim(rows) ? progress : nullptr;
+
+        auto emit = [&](const Block& block, size_t n) {
+            out.write(block.text.data(), static_cast<std::streamsize>(block.size));
+            if (!out) {
+                throw std::runtime_error("Error: could not write the table");
+            }
+            if (reporting != nullptr) reporting->advance(n);
+        };
+        auto length = [&](uint64_t b) {
+            return static_cast<size_t>(std::min<uint64_t>(BLOCK, rows - b * BLOCK));
+        };
+
+        // Programs with integ move their variables as they run, so their
+        // blocks are evaluated one after another on this thread.
+        if (!f.pure()) {
+            Block block;
+            for (uint64_t b = 0; b < blocks; ++b) {
+                if (progress != nullptr) progress->check();
+                fill(f, x, start, step, b * BLOCK, length(b), block);
+                emit(block, length(b));
+            }
+            x->set(at(start, step, rows - 1));
+            return;
+        }
+
+        // Blocks go out in rounds of one per worker. While a round is
+        // written, the next is being filled, and a round is always written
+        // in block order, so the output does not depend on scheduling.
+        workers = static_cast<size_t>(std::min<uint64_t>(resolveWorkers(workers), blocks));
+
+        std::vector<Block> ready(workers);
+        std::vector<Block> filling(workers);
+        std::vector<std::thread> threads;
+
+        auto launch = [&](uint64_t first) {
+            for (size_t i = 0; i < workers && first + i < blocks; ++i) {
+                threads.emplace_back([&, i, first]() {
+                    Block& block = filling[i];
+                    try {
+                        fill(f, x, start, step, (first + i) * BLOCK, length(first + i), block);
+                    } catch (...) {
+                        block.error = std::current_exception();
+                    }
+                });
+            }
+        };
+        auto join = [&]() {
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+            threads.clear();
+        };
+
+        launch(0);
+        for (uint64_t first = 0; first < blocks; first += workers) {
+            join();
+            ready.swap(filling);
+
+            try {
+                if (progress != nullptr) progress->check();
+                if (first + workers < blocks) launch(first + workers);
+
+                for (size_t i = 0; i < workers && first + i < blocks; ++i) {
+                    if (ready[i].error) std::rethrow_exception(ready[i].error);
+                    emit(ready[i], length(first + i));
+                }
+            } catch (...) {
+                join();
+                throw;
+            }
+        }
+
+        x->set(at(start, step, rows - 1));
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include "program.h"
+#include "progress.h"
+
+namespace Acalc {
+
+    // Tabulates f(x) as "x,value" lines for x = start, start + step, ...
+    // Rows are evaluated BLOCK at a time in one batch and formatted with
+    // std::to_chars, which gives the shortest text that reads back as the
+    // same float, into a buffer per block. The stream is written a whole
+    // block at a time and never flushed, so a long table is bound by the
+    // stream's sink rather than by formatting. Programs without integ are
+    // evaluated and formatted on worker threads while the calling thread
+    // writes out the blocks before, in order.
+    class Table {
+        public:
+            static constexpr size_t BLOCK = size_t(1) << 16;
+            static constexpr uint64_t MAX_ROWS = uint64_t(1) << 48;
+
+            // The number of rows from start towards end. end itself is the
+            // last row if it is a whole number of steps away once rounded
+            // to float, and there are no rows if step points away from it.
+            static uint64_t rows(double start, double end, double step);
+
+            // Row i is at x = float(start + i * step), computed in double so
+            // that the steps do not drift. x is left at the last row.
+            // `progress` is polled before every block. `workers` threads
+            // fill blocks, 0 for one per core.
+            static void write(const Program& f, Environment::Slot* x, double start, double step, uint64_t rows,
+                              std::ostream& out, Progress* progress = nullptr, size_t workers = 0);
+    };
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+
+namespace Acalc {
+
+    // The threads a parallel loop runs on, given a configured count where 0
+    // means one per core.
+    inline size_t resolveWorkers(size_t workers) {
+        return workers != 0 ? workers : std::max(1u, std::thread::hardware_concurrency());
+    }
+}
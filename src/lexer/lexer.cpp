@@ -6,10 +6,10 @@ namespace Acalc {
     std::vector<Token> Lexer::getTokens() {
         std::vector<Token> tokens;
 
-        while (!isAtEnd()) {
+        while (true) {
             Token token = getNextToken();
+            if (token.type == TOKEN_EOF) break;
             tokens.push_back(token);
-            advance();
         }
 
         tokens.emplace_back(TOKEN_EOF, "");
@@ -21,7 +21,14 @@ namespace Acalc {
 
         skipWhitespace();
 
-        switch (peek()) {
+        if (isAtEnd()) {
+            return Token(TOKEN_EOF, "");
+        }
+
+        char c = peek();
+        advance();
+
+        switch (c) {
             case '(': return Token(TOKEN_LEFT_PAREN, "("); break;
             case ')': return Token(TOKEN_RIGHT_PAREN, ")"); break;
             case '{': return Token(TOKEN_LEFT_BRACE, "{"); break;
@@ -34,22 +41,35 @@ namespace Acalc {
             case '^': return Token(TOKEN_POWER, "^"); break;
             case ';': return Token(TOKEN_SEMICOLON, ";"); break;
             case '=': return Token(TOKEN_EQUAL, "="); break;
+            case '"': return string();
             default:
-                      if (isdigit(peek())) {
-                          return number();
-                      } else if (isalpha(peek())) {
-                          return identifier();
+                      if (isdigit(c)) {
+                          return number(c);
+                      } else if (isalpha(c)) {
+                          return identifier(c);
                       }
         }
 
         return Token(TOKEN_ERROR, "err");
     }
 
+    bool Lexer::refill() {
+        if (in == nullptr || !*in) return false;
+
+        in->read(window.data(), window.size());
+        size_t n = static_cast<size_t>(in->gcount());
+
+        code = std::string_view(window.data(), n);
+        cur = 0;
+        return n > 0;
+    }
+
     void Lexer::skipWhitespace() {
         while (true) {
             switch (peek()) {
                 case '\n':
                 case '\r':
+                case '\t':
                 case ' ': advance(); break;
                 default:
                     return;
@@ -57,37 +77,51 @@ namespace Acalc {
         }
     }
 
-    Token Lexer::number() {
-        size_t start = cur;
+    Token Lexer::number(char first) {
+        std::string num(1, first);
 
         while (isdigit(peek())) {
+            num += peek();
             advance();
         }
 
         if (peek() == '.') {
+            num += '.';
             advance();
         }
 
         while (isdigit(peek())) {
+            num += peek();
             advance();
         }
 
-        --cur;
-
-        return Token(TOKEN_NUMBER, code.substr(start, cur - start + 1));
+        return Token(TOKEN_NUMBER, num);
     }
 
-    Token Lexer::identifier() {
-        size_t start = cur;
-        advance();
+    // A string runs to the next quote on the same line, with no escapes.
+    Token Lexer::string() {
+        std::string text;
 
-        while (isalpha(peek()) || isdigit(peek())) {
+        while (!isAtEnd() && peek() != '"' && peek() != '\n') {
+            text += peek();
             advance();
         }
 
-        --cur;
+        if (peek() != '"') {
+            return Token(TOKEN_ERROR, "unterminated string");
+        }
+        advance();
 
-        std::string iden = code.substr(start, cur - start + 1);
+        return Token(TOKEN_STRING, text);
+    }
+
+    Token Lexer::identifier(char first) {
+        std::string iden(1, first);
+
+        while (isalpha(peek()) || isdigit(peek())) {
+            iden += peek();
+            advance();
+        }
 
         switch (iden[0]) {
             case 'a': {
@@ -138,6 +172,12 @@ namespace Acalc {
                 if (iden == "integ") {
                     return Token(TOKEN_INTEG, iden);
                 }
+                if (iden == "implicit") {
+                    return Token(TOKEN_IMPLICIT, iden);
+                }
+                if (iden == "into") {
+                    return Token(TOKEN_INTO, iden);
+                }
             } break;
             case 'l': {
                 switch (iden[1]) {
@@ -160,6 +200,15 @@ namespace Acalc {
                 if (iden == "plot") {
                     return Token(TOKEN_PLOT, iden);
                 }
+                if (iden == "pgraph") {
+                    return Token(TOKEN_PGRAPH, iden);
+                }
+                if (iden == "polar") {
+                    return Token(TOKEN_POLAR, iden);
+                }
+                if (iden == "precision") {
+                    return Token(TOKEN_PRECISION, iden);
+                }
             } break;
             case 's': {
                 if (iden == "sec") {
@@ -176,6 +225,9 @@ namespace Acalc {
                 if (iden == "tan") {
                     return Token(TOKEN_TAN, iden);
                 }
+                if (iden == "table") {
+                    return Token(TOKEN_TABLE, iden);
+                }
             } break;
             case 'v': {
                 if (iden == "var") {
@@ -185,8 +237,4 @@ namespace Acalc {
         }
         return Token(TOKEN_IDENTIFIER, iden);
     }
-
-    bool Lexer::isAtEnd() const {
-        return cur >= code.length() || peek() == '\0';
-    }
 }
@@ -1,30 +1,43 @@
 #pragma once
 
+#include <istream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "../token/token.h"
 
 namespace Acalc {
 
+    // Produces tokens on demand. A lexer over a string reads it in place, so
+    // the string must outlive the lexer. A lexer over a stream reads it
+    // through a fixed-size window, so memory use does not grow with the
+    // size of the input.
     class Lexer {
         public:
-            Lexer(const std::string& code) : code{code}, cur{} {}
+            Lexer(std::string_view code) : code{code}, in{nullptr}, cur{} {}
+            Lexer(std::istream& in) : in{&in}, window(WINDOW_SIZE), cur{} {}
 
             std::vector<Token> getTokens();
             Token getNextToken();
 
         private:
-            bool isAtEnd() const;
-            char peek() const { return code[cur]; }
+            bool isAtEnd() { return peek() == '\0'; }
+            char peek() { return cur < code.size() || refill() ? code[cur] : '\0'; }
             void advance() { ++cur; }
+            bool refill();
 
             void skipWhitespace();
 
-            Token number();
-            Token identifier();
+            Token number(char first);
+            Token identifier(char first);
+            Token string();
 
         private:
-            const std::string code;
+            static constexpr size_t WINDOW_SIZE = 1 << 16;
+
+            std::string_view code;
+            std::istream* in;
+            std::vector<char> window;
             size_t cur;
     };
 }
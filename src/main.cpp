@@ -1,66 +1,52 @@
 #include <iostream>
-#include <fstream>
 #include <thread>
-#include "lexer/lexer.h"
-#include "parser/parser.h"
-#include "interpreter/interpreter.h"
 #include "graph/engine.h"
-
-Acalc::Interpreter interpreter;
-
-void exec(const std::string& code) {
-    Acalc::Lexer lexer(code);
-    auto tokens = lexer.getTokens();
-
-    Acalc::Parser parser(tokens);
-    std::vector<std::unique_ptr<Acalc::Stmt>> stmts;
-
-    std::unique_ptr<Acalc::Stmt> stmt = nullptr;
-
-    try {
-        while ((stmt = parser.parse()) != nullptr) {
-            interpreter.interpret(stmt);
-        }
-    } catch (const std::runtime_error& e) {
-        std::cout << e.what() << std::endl;
-    } catch (const std::string& err) {
-        std::cout << err << std::endl;
-    } catch (const char* err) {
-        std::cout << err << std::endl;
-    }
-}
+#include "canvas/engine_canvas.h"
+#include "canvas/scene.h"
+#include "session/session.h"
+#include "console/console.h"
+#ifdef __linux__
+#include "server/server.h"
+#endif
+
+Acalc::EngineCanvas engine;
+Acalc::Scene canvas(engine);
+Acalc::Session session(std::cout, &canvas);
 
 void repl() {
-
-    std::string line;
-
-    while (true) {
-        std::cout << ">> ";
-        std::getline(std::cin, line);
-        exec(line);
-    }
+    Acalc::Console console(session);
+    console.run();
+    if (session.exited()) exit(0);
 }
 
 void read(const std::string& filename) {
-    std::ifstream file(filename);
-
-    if (!file.is_open()) {
-        std::cerr << "Couldn't read file " << filename << ".";
-        return;
-    }
-
-    std::string code;
-    std::string line;
+    session.runFile(filename);
+    if (session.exited()) exit(0);
+}
 
-    while (std::getline(file, line)) {
-        code += line;
+#ifdef __linux__
+// Headless: no window is opened and every client gets its own session.
+int serve(const std::string& path) {
+    try {
+        Acalc::Server server(path);
+        std::cerr << "Serving on " << path << std::endl;
+        server.run();
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
     }
-
-    exec(code);
+    return 0;
 }
+#endif
 
 int main(int argc, char* argv[]) {
 
+#ifdef __linux__
+    if (argc == 3 && std::string(argv[1]) == "--serve") {
+        return serve(argv[2]);
+    }
+#endif
+
     std::thread thread1([argc, argv]() {
         switch (argc) {
             case 1: repl(); break;
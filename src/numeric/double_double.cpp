@@ -0,0 +1,864 @@
+#include "double_double.h"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <system_error>
+#include <vector>
+
+// A double-double product is one fused multiply-add, but without FMA in
+// the target, std::fma is a library call that also spills every register
+// the kernels hold their terms in. Where the toolchain can, the kernels
+// are built twice, with FMA instructions and without, and the loader picks
+// the one the processor runs.
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__) && !defined(__FMA__)
+#define ACALC_KERNEL __attribute__((target_clones("fma", "default")))
+#else
+#define ACALC_KERNEL
+#endif
+
+namespace Acalc {
+
+    namespace {
+
+        constexpr DD TWO_PI{ 6.283185307179586232e+00, 2.449293598294706414e-16 };
+
+        // The tables split a quarter turn and the mantissas from 0.75 to
+        // 1.5 into STEPS parts each, and an octave into OCTAVE_STEPS,
+        // which is the square of ROOT_STEPS.
+        constexpr int STEPS = 128;
+        constexpr int ROOT_STEPS = 32;
+        constexpr int OCTAVE_STEPS = ROOT_STEPS * ROOT_STEPS;
+
+        // pi/2 over STEPS and ln 2 over OCTAVE_STEPS as three doubles each,
+        // so that a multiple of them can be taken off an argument with the
+        // first two products exact.
+        constexpr double PI_STEP[3] = { 1.570796326794896558e+00 / STEPS, 6.123233995736766036e-17 / STEPS,
+                                        -1.497384904859169833e-33 / STEPS };
+        constexpr double LN2_STEP[3] = { 6.931471805599452862e-01 / OCTAVE_STEPS,
+                                         2.319046813846299558e-17 / OCTAVE_STEPS,
+                                         5.707708438416212066e-34 / OCTAVE_STEPS };
+
+        constexpr int FACTORIALS = 28;
+
+        // INV_FACT[i] = 1 / (i + 3)!
+        struct InverseFactorials {
+            DD values[FACTORIALS];
+
+            InverseFactorials() {
+                DD f(2);
+                for (int i = 0; i < FACTORIALS; ++i) {
+                    f = f * static_cast<double>(i + 3);
+                    values[i] = DD(1) / f;
+                }
+            }
+        };
+
+        const DD* inverseFactorials() {
+            static const InverseFactorials table;
+            return table.values;
+        }
+
+        DD sqr(const DD& a) {
+            DD p = DDMath::twoProd(a.hi, a.hi);
+            return DDMath::settle(p.hi, p.lo + 2 * a.hi * a.lo);
+        }
+
+        // The helpers below stand in for std::ldexp, std::frexp and
+        // std::nearbyint, which are library calls on targets without
+        // SSE4.1, and as such cost the kernels as much as their series.
+
+        DD ldexp(const DD& a, int e) {
+            if (e >= -1022 && e <= 1023) {
+                double scale = std::bit_cast<double>(static_cast<uint64_t>(e + 1023) << 52);
+                return { a.hi * scale, a.lo * scale };
+            }
+            return { std::ldexp(a.hi, e), std::ldexp(a.lo, e) };
+        }
+
+        // The exponent std::frexp would give for a finite a.
+        int exponent(double a) {
+            int biased = static_cast<int>((std::bit_cast<uint64_t>(a) >> 52) & 0x7ff);
+            if (biased == 0) {
+                int e;
+                std::frexp(a, &e);
+                return e;
+            }
+            return biased - 1022;
+        }
+
+        // a rounded to the nearest integer, for |a| < 2^51.
+        double nearest(double a) {
+            constexpr double SHIFT = 0x1.8p52;
+            return (a + SHIFT) - SHIFT;
+        }
+
+        // The kernels' own + and *, without the overflow checks, for finite
+        // terms. add() is also sloppier than operator+: its error is
+        // relative to |a| + |b| rather than to the sum, which is as good
+        // when the terms do not cancel, as in a series.
+        DD add(const DD& a, const DD& b) {
+            DD s = DDMath::twoSum(a.hi, b.hi);
+            return DDMath::quickTwoSum(s.hi, s.lo + a.lo + b.lo);
+        }
+
+        DD mul(const DD& a, const DD& b) {
+            DD p = DDMath::twoProd(a.hi, b.hi);
+            return DDMath::quickTwoSum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+        }
+
+        // a - n c for c given as three doubles.
+        DD reduce(const DD& a, double n, const double (&c)[3]) {
+            DD r = a - DDMath::twoProd(c[0], n);
+            r = add(r, -DDMath::twoProd(c[1], n));
+            return add(r, DD(-c[2] * n));
+        }
+
+        // The series the kernels start from, converging slowly but needing
+        // no tables. They only build the tables.
+
+        // sin a for |a| <= pi/4.
+        DD sinSeries(const DD& a) {
+            if (a.hi == 0) return DD(0);
+
+            const DD* inv = inverseFactorials();
+            DD x = -sqr(a);
+            DD s = a;
+            DD r = a;
+            for (int i = 0; i < FACTORIALS; i += 2) {
+                r = r * x;
+                DD t = r * inv[i];
+                s = s + t;
+                if (std::abs(t.hi) <= DDMath::EPS * std::abs(a.hi)) break;
+            }
+            return s;
+        }
+
+        // e^a for |a| <= 1.
+        DD expSeries(const DD& a) {
+            if (a.hi == 0) return DD(1);
+
+            // a is shrunk by 2^9 so that a short series converges, and the
+            // result squared back up.
+            constexpr int K = 9;
+            constexpr double INV_K = 1.0 / (1 << K);
+            DD r = ldexp(a, -K);
+
+            const DD* inv = inverseFactorials();
+            DD p = sqr(r);
+            DD s = r + ldexp(p, -1);
+            for (int i = 0; i < FACTORIALS; ++i) {
+                p = p * r;
+                DD t = p * inv[i];
+                s = s + t;
+                if (std::abs(t.hi) <= INV_K * DDMath::EPS) break;
+            }
+
+            // (1 + s)^2 - 1 = 2s + s^2 keeps the small part exact.
+            for (int i = 0; i < K; ++i) {
+                s = ldexp(s, 1) + sqr(s);
+            }
+            return s + DD(1);
+        }
+
+        // log((1 + u) / (1 - u)) = 2 atanh u for |u| <= 1/3.
+        DD atanhSeries(const DD& u) {
+            if (u.hi == 0) return DD(0);
+
+            DD x = sqr(u);
+            DD s = u;
+            DD p = u;
+            for (int k = 1; k < 64; ++k) {
+                p = p * x;
+                DD t = p / DD(2 * k + 1);
+                s = s + t;
+                if (std::abs(t.hi) <= DDMath::EPS * std::abs(u.hi)) break;
+            }
+            return ldexp(s, 1);
+        }
+
+        // What the kernels look up, built once from the series above.
+        struct Tables {
+            // Of k pi/2 / STEPS for k = 0..STEPS/2.
+            DD sines[STEPS / 2 + 1];
+            DD cosines[STEPS / 2 + 1];
+            // 2^(j / OCTAVE_STEPS) for j = 0..OCTAVE_STEPS-1.
+            DD powers[OCTAVE_STEPS];
+            // log(1 + j / STEPS) for j = -STEPS/4..STEPS/2, at logs[j + STEPS/4].
+            DD logs[3 * STEPS / 4 + 1];
+            // 1/3 and 1/5.
+            DD odd[2];
+
+            Tables() {
+                for (int k = 0; k <= STEPS / 2; ++k) {
+                    sines[k] = sinSeries(DD_PI * (k / (2.0 * STEPS)));
+                    cosines[k] = sqrt(DD(1) - sqr(sines[k]));
+                }
+                // Each a product of two series results, which is as accurate
+                // as one and far quicker to build.
+                DD coarse[ROOT_STEPS], fine[ROOT_STEPS];
+                for (int i = 0; i < ROOT_STEPS; ++i) {
+                    coarse[i] = expSeries(DD_LN2 * (static_cast<double>(i) / ROOT_STEPS));
+                    fine[i] = expSeries(DD_LN2 * (static_cast<double>(i) / OCTAVE_STEPS));
+                }
+                for (int j = 0; j < OCTAVE_STEPS; ++j) {
+                    powers[j] = coarse[j / ROOT_STEPS] * fine[j % ROOT_STEPS];
+                }
+                for (int j = -STEPS / 4; j <= STEPS / 2; ++j) {
+                    logs[j + STEPS / 4] = atanhSeries(DD(j) / DD(2 * STEPS + j));
+                }
+                for (int k = 0; k < 2; ++k) {
+                    odd[k] = DD(1) / DD(2 * k + 3);
+                }
+            }
+        };
+
+        const Tables& tables() {
+            static const Tables table;
+            return table;
+        }
+
+        // The binary fraction of 1 / (2 pi), 32 bits a word, as far as the
+        // largest doubles need it.
+        constexpr uint32_t INV_TWO_PI[48] = {
+            0x28be60db, 0x9391054a, 0x7f09d5f4, 0x7d4d3770, 0x36d8a566, 0x4f10e410,
+            0x7f9458ea, 0xf7aef158, 0x6dc91b8e, 0x909374b8, 0x01924bba, 0x82746487,
+            0x3f877ac7, 0x2c4a69cf, 0xba208d7d, 0x4baed121, 0x3a671c09, 0xad17df90,
+            0x4e64758e, 0x60d4ce7d, 0x272117e2, 0xef7e4a0e, 0xc7fe25ff, 0xf7816603,
+            0xfbcbc462, 0xd6829b47, 0xdb4d9fb3, 0xc9f2c26d, 0xd3d18fd9, 0xa797fa8b,
+            0x5d49eeb1, 0xfaf97c5e, 0xcf41ce7d, 0xe294a4ba, 0x9afed7ec, 0x47e35742,
+            0x1580cc11, 0xbf1edaea, 0xfc33ef08, 0x26bd0d87, 0x6a78e458, 0x57b986c2,
+            0x19666157, 0xc5281a10, 0x237ff620, 0x135cc9cc, 0x41818555, 0xb29cea32,
+        };
+
+        // Words of a fraction of a turn in the exact reduction.
+        constexpr int TURN_WORDS = 12;
+
+        // Bits i+1 to i+32 of that fraction; those before the point are 0.
+        uint32_t inverseTwoPiBits(int i) {
+            auto word = [](int w) -> uint64_t { return w >= 0 && w < 48 ? INV_TWO_PI[w] : 0; };
+            int w = i >= 0 ? i / 32 : -((31 - i) / 32);
+            int shift = i - 32 * w;
+            return static_cast<uint32_t>(((word(w) << 32 | word(w + 1)) << shift) >> 32);
+        }
+
+        // Adds frac(p / 2 pi) onto the fraction f (least significant word
+        // first, modulo 1). With p = m 2^k, the bits of 1 / (2 pi) down to
+        // 2^-k only make whole turns, so m times the next few hundred of
+        // them is all that is needed (Payne and Hanek).
+        void addTurns(double p, uint32_t f[TURN_WORDS]) {
+            int k;
+            uint64_t m = static_cast<uint64_t>(std::ldexp(std::frexp(std::abs(p), &k), 53));
+            k -= 53;
+
+            uint32_t w[TURN_WORDS];
+            for (int i = 0; i < TURN_WORDS; ++i) {
+                w[i] = inverseTwoPiBits(k + 32 * (TURN_WORDS - 1 - i));
+            }
+            uint32_t product[TURN_WORDS];
+            uint64_t carry = 0;
+            for (int i = 0; i < TURN_WORDS; ++i) {
+                carry += static_cast<uint64_t>(w[i]) * static_cast<uint32_t>(m);
+                product[i] = static_cast<uint32_t>(carry);
+                carry >>= 32;
+            }
+            carry = 0;
+            for (int i = 0; i + 1 < TURN_WORDS; ++i) {
+                carry += static_cast<uint64_t>(w[i]) * static_cast<uint32_t>(m >> 32) + product[i + 1];
+                product[i + 1] = static_cast<uint32_t>(carry);
+                carry >>= 32;
+            }
+
+            // -x turns is 1 - x of one.
+            uint64_t sum = p < 0 ? 1 : 0;
+            for (int i = 0; i < TURN_WORDS; ++i) {
+                sum += static_cast<uint64_t>(f[i]) + (p < 0 ? ~product[i] : product[i]);
+                f[i] = static_cast<uint32_t>(sum);
+                sum >>= 32;
+            }
+        }
+
+        // a = n pi/2 / STEPS + t with |t| <= pi/4 / STEPS, up to whole
+        // turns, as sincos takes it apart, for arguments too large to take n pi/2 / STEPS off
+        // directly: n would not fit a double, and the digits of pi it
+        // brings into play go far past a double-double's. Here t is exact
+        // to about 2^-330, so it keeps its bits however close to a multiple
+        // a double-double can come.
+        DD reduceTurns(const DD& a, double& n) {
+            uint32_t f[TURN_WORDS] = {};
+            addTurns(a.hi, f);
+            if (a.lo != 0) addTurns(a.lo, f);
+
+            // A turn is 4 STEPS steps, so n is the fraction's top bits,
+            // rounded, and t what is left below them.
+            static_assert(4 * STEPS == 1 << 9);
+            constexpr int SHIFT = 32 - 9;
+            uint32_t& top = f[TURN_WORDS - 1];
+            bool up = ((top >> (SHIFT - 1)) & 1) != 0;
+            n = static_cast<double>((top >> SHIFT) + (up ? 1 : 0));
+            top &= (1u << SHIFT) - 1;
+            if (up) {
+                // The step above less the fraction.
+                uint64_t sum = 1;
+                for (int i = 0; i < TURN_WORDS; ++i) {
+                    sum += static_cast<uint32_t>(~f[i]);
+                    f[i] = static_cast<uint32_t>(sum);
+                    sum >>= 32;
+                }
+                top = (top + (1u << SHIFT)) & ((1u << SHIFT) - 1);
+            }
+
+            DD turns;
+            for (int i = TURN_WORDS - 1; i >= 0; --i) {
+                turns += DD(std::ldexp(static_cast<double>(f[i]), -32 * (TURN_WORDS - i)));
+            }
+            DD t = turns * TWO_PI;
+            return up ? -t : t;
+        }
+
+        // The kernels below sum the large terms of their series in
+        // double-double and the small ones in double, which is several
+        // times cheaper and loses nothing once a term is below about 2^-50
+        // of the result.
+
+        // sin and cos of a = n pi/2 / STEPS + t, with |t| <= pi/4 / STEPS,
+        // from sin t and cos t and the table for the multiple.
+        ACALC_KERNEL void sincos(DD a, DD& s, DD& c) {
+            if (!std::isfinite(a.hi)) {
+                s = c = DD(std::numeric_limits<double>::quiet_NaN());
+                return;
+            }
+            // Huge arguments, and those so close to a multiple of the step
+            // that taking it off cancels past the digits of PI_STEP, are
+            // reduced exactly instead.
+            double n = 0;
+            DD t;
+            bool exact = std::abs(a.hi) > 0x1p40;
+            if (!exact) {
+                n = nearest(a.hi * (1 / PI_STEP[0]));
+                t = reduce(a, n, PI_STEP);
+                exact = std::abs(t.hi) < 0x1p-50 * std::abs(a.hi);
+            }
+            if (exact) t = reduceTurns(a, n);
+
+            const DD* inv = inverseFactorials();
+            DD y = -sqr(t);
+            double yh = y.hi;
+
+            // sin t = t (1 + y/3! + y^2/5! + ...) with y = -t^2, in
+            // double from y^3 on.
+            DD st((inv[8].hi * yh + inv[6].hi) * yh + inv[4].hi);
+            st = add(mul(st, y), inv[2]);
+            st = add(mul(st, y), inv[0]);
+            st = mul(t, add(mul(st, y), DD(1)));
+
+            // cos t = 1 + y/2! + y^2/4! + ..., likewise.
+            DD ct((inv[7].hi * yh + inv[5].hi) * yh + inv[3].hi);
+            ct = add(mul(ct, y), inv[1]);
+            ct = add(mul(ct, y), DD(0.5));
+            ct = add(mul(ct, y), DD(1));
+
+            // n = STEPS q + k with k in [-STEPS/2, STEPS/2): a quarter
+            // turn q and k steps of the table.
+            long long m = static_cast<long long>(n) & (4 * STEPS - 1);
+            long long turns = (m + STEPS / 2) / STEPS;
+            int q = static_cast<int>(turns & 3);
+            int k = static_cast<int>(m - STEPS * turns);
+            if (k != 0) {
+                const Tables& table = tables();
+                DD sk = k < 0 ? -table.sines[-k] : table.sines[k];
+                const DD& ck = table.cosines[k < 0 ? -k : k];
+                DD s1 = add(mul(st, ck), mul(ct, sk));
+                ct = add(mul(ct, ck), -mul(st, sk));
+                st = s1;
+            }
+
+            switch (q) {
+                case 0: s = st; c = ct; break;
+                case 1: s = ct; c = -st; break;
+                case 2: s = -st; c = -ct; break;
+                default: s = -ct; c = st; break;
+            }
+        }
+
+        // Just enough of an unsigned big integer for DD::parse to find
+        // the exact remainder of a decimal after its nearest double.
+        class Big {
+            public:
+                explicit Big(uint64_t v = 0) {
+                    for (; v != 0; v >>= 32) limbs.push_back(static_cast<uint32_t>(v));
+                }
+
+                bool zero() const { return limbs.empty(); }
+
+                int bits() const {
+                    if (limbs.empty()) return 0;
+                    int n = 32 * static_cast<int>(limbs.size() - 1);
+                    for (uint32_t top = limbs.back(); top != 0; top >>= 1) ++n;
+                    return n;
+                }
+
+                void add(uint32_t v) {
+                    uint64_t carry = v;
+                    for (size_t i = 0; carry != 0 && i < limbs.size(); ++i) {
+                        carry += limbs[i];
+                        limbs[i] = static_cast<uint32_t>(carry);
+                        carry >>= 32;
+                    }
+                    if (carry != 0) limbs.push_back(static_cast<uint32_t>(carry));
+                }
+
+                void mul(uint32_t v) {
+                    uint64_t carry = 0;
+                    for (uint32_t& limb : limbs) {
+                        carry += static_cast<uint64_t>(limb) * v;
+                        limb = static_cast<uint32_t>(carry);
+                        carry >>= 32;
+                    }
+                    if (carry != 0) limbs.push_back(static_cast<uint32_t>(carry));
+                    trim();
+                }
+
+                void mul(uint64_t v) {
+                    Big high = *this;
+                    high.mul(static_cast<uint32_t>(v >> 32));
+                    high.shiftLeft(32);
+                    mul(static_cast<uint32_t>(v));
+                    add(high);
+                }
+
+                void mulPow5(long long n) {
+                    // 5^13 is the largest power of 5 in 32 bits.
+                    for (; n >= 13; n -= 13) mul(1220703125u);
+                    for (; n > 0; --n) mul(5u);
+                }
+
+                void shiftLeft(long long n) {
+                    if (limbs.empty() || n == 0) return;
+                    limbs.insert(limbs.begin(), static_cast<size_t>(n / 32), 0);
+                    int bits = static_cast<int>(n % 32);
+                    if (bits == 0) return;
+                    uint32_t carry = 0;
+                    for (uint32_t& limb : limbs) {
+                        uint32_t next = limb >> (32 - bits);
+                        limb = (limb << bits) | carry;
+                        carry = next;
+                    }
+                    if (carry != 0) limbs.push_back(carry);
+                }
+
+                void shiftRight1() {
+                    for (size_t i = 0; i < limbs.size(); ++i) {
+                        limbs[i] >>= 1;
+                        if (i + 1 < limbs.size()) limbs[i] |= limbs[i + 1] << 31;
+                    }
+                    trim();
+                }
+
+                void add(const Big& b) {
+                    if (limbs.size() < b.limbs.size()) limbs.resize(b.limbs.size(), 0);
+                    uint64_t carry = 0;
+                    for (size_t i = 0; i < limbs.size(); ++i) {
+                        carry += static_cast<uint64_t>(limbs[i]) + (i < b.limbs.size() ? b.limbs[i] : 0);
+                        limbs[i] = static_cast<uint32_t>(carry);
+                        carry >>= 32;
+                    }
+                    if (carry != 0) limbs.push_back(static_cast<uint32_t>(carry));
+                }
+
+                // Requires *this >= b.
+                void sub(const Big& b) {
+                    int64_t borrow = 0;
+                    for (size_t i = 0; i < limbs.size(); ++i) {
+                        int64_t d = static_cast<int64_t>(limbs[i]) - (i < b.limbs.size() ? b.limbs[i] : 0) - borrow;
+                        borrow = d < 0;
+                        limbs[i] = static_cast<uint32_t>(d + (borrow << 32));
+                    }
+                    trim();
+                }
+
+                friend int compare(const Big& a, const Big& b) {
+                    if (a.limbs.size() != b.limbs.size()) return a.limbs.size() < b.limbs.size() ? -1 : 1;
+                    for (size_t i = a.limbs.size(); i-- > 0;) {
+                        if (a.limbs[i] != b.limbs[i]) return a.limbs[i] < b.limbs[i] ? -1 : 1;
+                    }
+                    return 0;
+                }
+
+            private:
+                void trim() {
+                    while (!limbs.empty() && limbs.back() == 0) limbs.pop_back();
+                }
+
+            private:
+                std::vector<uint32_t> limbs;
+        };
+
+        // n / d * 2^e rounded to the nearest double. The quotient is taken
+        // to 62 or 63 bits, with a sticky bit below them that says whether
+        // anything was left over.
+        double ratio(Big n, Big d, long long e) {
+            long long s = 62 + d.bits() - n.bits();
+            if (s >= 0) {
+                n.shiftLeft(s);
+            } else {
+                d.shiftLeft(-s);
+            }
+
+            uint64_t q = 0;
+            d.shiftLeft(62);
+            for (int i = 62; i >= 0; --i) {
+                q <<= 1;
+                if (compare(n, d) >= 0) {
+                    n.sub(d);
+                    q |= 1;
+                }
+                d.shiftRight1();
+            }
+            if (!n.zero()) q |= 1;
+
+            // Rounded here rather than by the conversion, as subnormal
+            // results keep fewer than 53 bits.
+            e -= s;
+            int length = 64 - std::countl_zero(q);
+            long long drop = length - 53;
+            long long top = length - 1 + e;
+            if (top < -1022) drop += -1022 - top;
+            if (drop >= 64) return 0;
+
+            uint64_t kept = q >> drop;
+            uint64_t rest = q & ((uint64_t(1) << drop) - 1);
+            uint64_t half = uint64_t(1) << (drop - 1);
+            if (rest > half || (rest == half && (kept & 1) != 0)) ++kept;
+            return std::ldexp(static_cast<double>(kept), static_cast<int>(e + drop));
+        }
+    }
+
+    DD sqrt(const DD& a) {
+        if (a.hi == 0) return DD(0);
+        if (a.hi < 0) return DD(std::numeric_limits<double>::quiet_NaN());
+        if (!std::isfinite(a.hi)) return a;
+
+        // One Newton step on the double square root (Karp's method).
+        double x = 1.0 / std::sqrt(a.hi);
+        double ax = a.hi * x;
+        return DDMath::twoSum(ax, (a - sqr(DD(ax))).hi * (x * 0.5));
+    }
+
+    ACALC_KERNEL DD exp(const DD& a) {
+        if (std::isnan(a.hi)) return a;
+        if (a.hi > 709.8) return DD(std::numeric_limits<double>::infinity());
+        if (a.hi < -745.2) return DD(0);
+        if (a.hi == 0) return DD(1);
+
+        // a = (OCTAVE_STEPS m + j) ln 2 / OCTAVE_STEPS + r with r at most
+        // half a step, so e^a is 2^m 2^(j / OCTAVE_STEPS) e^r.
+        double n = nearest(a.hi * (1 / LN2_STEP[0]));
+        DD r = reduce(a, n, LN2_STEP);
+        long long whole = static_cast<long long>(n);
+        int j = static_cast<int>(whole & (OCTAVE_STEPS - 1));
+        int m = static_cast<int>((whole - j) / OCTAVE_STEPS);
+
+        // e^r - 1 = r (1 + r/2! + r^2/3! + ...), in double from r^3 on.
+        const DD* inv = inverseFactorials();
+        double rh = r.hi;
+        DD s(((inv[4].hi * rh + inv[3].hi) * rh + inv[2].hi) * rh + inv[1].hi);
+        s = add(mul(s, r), inv[0]);
+        s = add(mul(s, r), DD(0.5));
+        s = add(mul(s, r), DD(1));
+        s = mul(s, r);
+
+        const DD& power = tables().powers[j];
+        return ldexp(add(power, mul(power, s)), m);
+    }
+
+    ACALC_KERNEL DD log(const DD& a) {
+        if (std::isnan(a.hi)) return a;
+        if (a.hi == 0) return DD(-std::numeric_limits<double>::infinity());
+        if (a.hi < 0) return DD(std::numeric_limits<double>::quiet_NaN());
+        if (!std::isfinite(a.hi)) return a;
+
+        // a = 2^e f with f in [0.75, 1.5), and c = 1 + j / STEPS is nearest
+        // f, so log a = e ln 2 + log c + 2 atanh u with u = (f - c)/(f + c)
+        // and |u| < 1 / 3 STEPS.
+        int e = exponent(a.hi);
+        DD f = ldexp(a, -e);
+        if (f.hi < 0.75) {
+            f = ldexp(f, 1);
+            --e;
+        }
+        double j = nearest((f.hi - 1) * STEPS);
+        double c = 1 + j / STEPS;
+        // f - c is exact. num / den is taken to about 2^-104 as in
+        // operator/, less its last step and with one division.
+        DD num = add(f, DD(-c));
+        DD den = add(f, DD(c));
+        double inverse = 1 / den.hi;
+        double q1 = num.hi * inverse;
+        DD rest = num - den * q1;
+        DD u = DDMath::quickTwoSum(q1, rest.hi * inverse);
+
+        // atanh u = u (1 + x/3 + x^2/5 + ...) with x = u^2, in double
+        // from x^3 on.
+        const Tables& table = tables();
+        DD x = sqr(u);
+        double xh = x.hi;
+        DD s((((xh / 13 + 1.0 / 11) * xh + 1.0 / 9) * xh + 1.0 / 7) * xh);
+        s = add(s, table.odd[1]);
+        s = add(mul(s, x), table.odd[0]);
+        s = add(mul(s, x), DD(1));
+        s = mul(ldexp(u, 1), s);
+
+        return DD_LN2 * static_cast<double>(e) + table.logs[static_cast<int>(j) + STEPS / 4] + s;
+    }
+
+    DD sin(const DD& a) {
+        DD s, c;
+        sincos(a, s, c);
+        return s;
+    }
+
+    DD cos(const DD& a) {
+        DD s, c;
+        sincos(a, s, c);
+        return c;
+    }
+
+    DD tan(const DD& a) {
+        DD s, c;
+        sincos(a, s, c);
+        return s / c;
+    }
+
+    DD pow(const DD& a, long long n) {
+        if (n == 0) return DD(1);
+        if (std::isnan(a.hi)) return a;
+        if (a.hi == 0 || std::isinf(a.hi)) {
+            double magnitude = (a.hi == 0) == (n > 0) ? 0.0 : std::numeric_limits<double>::infinity();
+            return DD((n & 1) ? std::copysign(magnitude, a.hi) : magnitude);
+        }
+
+        // The powers of two are carried apart in `scale`, so neither the
+        // squares nor a reciprocal overflow or underflow before the end:
+        // 2^-1100 is 1 / 2^1100, which has to come out as 0 and not as
+        // 1 / inf, and a subnormal result keeps what bits it can.
+        static constexpr long long LIMIT = 1ll << 40;
+        auto normalize = [](DD& x, long long& scale) {
+            if (std::abs(x.hi) > 0x1p400 || std::abs(x.hi) < 0x1p-400) {
+                int e = exponent(x.hi);
+                x = ldexp(x, -e);
+                scale = std::clamp(scale + e, -LIMIT, LIMIT);
+            }
+        };
+
+        unsigned long long k = n < 0 ? 0ull - static_cast<unsigned long long>(n) : static_cast<unsigned long long>(n);
+        DD base = a;
+        long long baseScale = 0;
+        DD result(1);
+        long long scale = 0;
+        while (true) {
+            if (k & 1) {
+                result = result * base;
+                scale = std::clamp(scale + baseScale, -LIMIT, LIMIT);
+                normalize(result, scale);
+            }
+            k >>= 1;
+            if (k == 0) break;
+            base = sqr(base);
+            baseScale = std::clamp(2 * baseScale, -LIMIT, LIMIT);
+            normalize(base, baseScale);
+        }
+        if (n < 0) {
+            result = DD(1) / result;
+            scale = -scale;
+        }
+
+        int e = exponent(result.hi);
+        if (scale + e > 1024) return DD(std::copysign(std::numeric_limits<double>::infinity(), result.hi));
+        if (scale + e < -1080) return DD(std::copysign(0.0, result.hi));
+        if (scale == 0) return result;
+        result = ldexp(result, static_cast<int>(scale));
+        return DDMath::settle(result.hi, result.lo);
+    }
+
+    DD pow(const DD& a, const DD& b) {
+        bool whole = std::abs(b.hi) < 0x1p51 ? nearest(b.hi) == b.hi : b.hi == std::floor(b.hi);
+        if (b.lo == 0 && whole && std::abs(b.hi) < 0x1p62) {
+            return pow(a, static_cast<long long>(b.hi));
+        }
+        if (a.hi == 0) {
+            return DD(b.hi > 0 ? 0 : std::numeric_limits<double>::infinity());
+        }
+
+        if (a.hi < 0) {
+            // Integers too large for repeated squaring are even.
+            if (b != floor(b)) return DD(std::numeric_limits<double>::quiet_NaN());
+            return exp(b * log(-a));
+        }
+        return exp(b * log(a));
+    }
+
+    DD DD::parse(std::string_view text) {
+        bool negative = !text.empty() && text[0] == '-';
+        if (!text.empty() && (text[0] == '-' || text[0] == '+')) {
+            text.remove_prefix(1);
+        }
+
+        // The value is digits * 10^exponent exactly.
+        Big digits;
+        long long exponent = 0;
+        bool point = false;
+        size_t i = 0;
+
+        for (; i < text.size(); ++i) {
+            char c = text[i];
+            if (c == '.') {
+                point = true;
+                continue;
+            }
+            if (c < '0' || c > '9') break;
+
+            digits.mul(10u);
+            digits.add(static_cast<uint32_t>(c - '0'));
+            if (point) --exponent;
+        }
+
+        if (i < text.size() && (text[i] == 'e' || text[i] == 'E')) {
+            ++i;
+            bool down = i < text.size() && text[i] == '-';
+            if (i < text.size() && (text[i] == '-' || text[i] == '+')) ++i;
+            long long power = 0;
+            for (; i < text.size() && text[i] >= '0' && text[i] <= '9' && power < 100000; ++i) {
+                power = power * 10 + (text[i] - '0');
+            }
+            exponent += down ? -power : power;
+        }
+
+        // hi is the nearest double, which std::from_chars guarantees. It
+        // only reports the range when the value overflows or underflows.
+        double hi = 0;
+        auto [end, ec] = std::from_chars(text.data(), text.data() + i, hi);
+        if (ec == std::errc::result_out_of_range) {
+            double magnitude = digits.bits() * 0.30103 + static_cast<double>(exponent);
+            hi = magnitude > 0 ? std::numeric_limits<double>::infinity() : 0;
+        } else if (ec != std::errc() || end != text.data() + i) {
+            hi = std::numeric_limits<double>::quiet_NaN();
+        }
+        if (hi == 0 || !std::isfinite(hi)) {
+            return DD(negative ? -hi : hi);
+        }
+
+        // lo is the nearest double to what hi leaves over. With hi = M 2^k
+        // and the value num/den 2^exponent, that is
+        // (num 2^(exponent - b) - M den 2^(k - b)) / den 2^b, with b the
+        // smaller power so that both sides are integers.
+        int k;
+        uint64_t m = static_cast<uint64_t>(std::ldexp(std::frexp(hi, &k), 53));
+        k -= 53;
+
+        Big num = digits;
+        Big den(1);
+        if (exponent >= 0) {
+            num.mulPow5(exponent);
+        } else {
+            den.mulPow5(-exponent);
+        }
+        long long b = std::min<long long>(exponent, k);
+        num.shiftLeft(exponent - b);
+        Big rest = den;
+        rest.mul(m);
+        rest.shiftLeft(k - b);
+
+        double lo = 0;
+        int order = compare(num, rest);
+        if (order > 0) {
+            num.sub(rest);
+            lo = ratio(num, den, b);
+        } else if (order < 0) {
+            rest.sub(num);
+            lo = -ratio(rest, den, b);
+        }
+        return negative ? DD(-hi, -lo) : DD(hi, lo);
+    }
+
+    std::string DD::format(int digits) const {
+        if (std::isnan(hi)) return "nan";
+        if (std::isinf(hi)) return hi < 0 ? "-inf" : "inf";
+        if (hi == 0) return std::signbit(hi) ? "-0" : "0";
+
+        std::string out;
+        DD r = abs(*this);
+        if (hi < 0) out += '-';
+
+        // Scale r into [1, 10).
+        int e = static_cast<int>(std::floor(std::log10(r.hi)));
+        if (e > 0) {
+            r = r / pow(DD(10), e);
+        } else if (e < 0) {
+            // 10^-e overflows for subnormal r, which takes a second step.
+            int step = std::min(-e, 300);
+            r = r * pow(DD(10), step);
+            if (step < -e) r = r * pow(DD(10), -e - step);
+        }
+        if (r.hi >= 10) { r = r / DD(10); ++e; }
+        if (r.hi < 1) { r = r * 10.0; --e; }
+
+        // One digit more than asked for, to round on.
+        std::string d(digits + 1, '0');
+        for (int i = 0; i <= digits; ++i) {
+            int k = static_cast<int>(std::floor(r.hi));
+            DD rest = r - DD(k);
+            if (rest.hi < 0) { --k; rest = rest + DD(1); }
+            if (k < 0) k = 0;
+            if (k > 9) k = 9;
+            d[i] = static_cast<char>('0' + k);
+            r = rest * 10.0;
+        }
+        bool up = d[digits] >= '5';
+        d.pop_back();
+        for (int i = digits - 1; up && i >= 0; --i) {
+            if (d[i] == '9') {
+                d[i] = '0';
+            } else {
+                ++d[i];
+                up = false;
+            }
+        }
+        if (up) {
+            d.insert(d.begin(), '1');
+            d.pop_back();
+            ++e;
+        }
+        while (d.size() > 1 && d.back() == '0') {
+            d.pop_back();
+        }
+
+        if (e < -4 || e >= digits) {
+            out += d[0];
+            if (d.size() > 1) {
+                out += '.';
+                out.append(d, 1);
+            }
+            char exponent[16];
+            std::snprintf(exponent, sizeof exponent, "e%c%02d", e < 0 ? '-' : '+', e < 0 ? -e : e);
+            out += exponent;
+        } else if (e < 0) {
+            out += "0.";
+            out.append(static_cast<size_t>(-e - 1), '0');
+            out += d;
+        } else {
+            int whole = e + 1;
+            if (static_cast<int>(d.size()) <= whole) {
+                out += d;
+                out.append(static_cast<size_t>(whole) - d.size(), '0');
+            } else {
+                out.append(d, 0, static_cast<size_t>(whole));
+                out += '.';
+                out.append(d, static_cast<size_t>(whole));
+            }
+        }
+        return out;
+    }
+}
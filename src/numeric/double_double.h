@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <string_view>
+
+namespace Acalc {
+
+    // A double-double number: the unevaluated sum hi + lo of two doubles,
+    // with |lo| at most half an ulp of hi. That gives a 106-bit significand
+    // (about 31 decimal digits) for the price of a few double operations,
+    // far cheaper than arbitrary precision. The algorithms follow the QD
+    // library of Hida, Li and Bailey; products rely on a fused multiply-add.
+    struct DD {
+        double hi = 0;
+        double lo = 0;
+
+        constexpr DD() = default;
+        constexpr explicit DD(double hi) : hi{hi} {}
+        constexpr DD(double hi, double lo) : hi{hi}, lo{lo} {}
+
+        // Reads a decimal number (an optional sign, digits with an optional
+        // point, and an optional exponent), correctly rounded: hi is the
+        // nearest double and lo the nearest to what hi leaves over.
+        static DD parse(std::string_view text);
+
+        // `digits` significant digits, with trailing zeros dropped, in the
+        // style of std::ostream's default float format.
+        std::string format(int digits = 31) const;
+    };
+
+    namespace DDMath {
+
+        // 2^-104, the spacing of double-double values near 1.
+        constexpr double EPS = 4.93038065763132e-32;
+
+        inline DD quickTwoSum(double a, double b) {
+            double s = a + b;
+            return { s, b - (s - a) };
+        }
+
+        inline DD twoSum(double a, double b) {
+            double s = a + b;
+            double bb = s - a;
+            return { s, (a - (s - bb)) + (b - bb) };
+        }
+
+        inline DD twoProd(double a, double b) {
+            double p = a * b;
+            return { p, std::fma(a, b, -p) };
+        }
+
+        // Keeps overflow and NaN in hi, where the error terms would turn
+        // them into NaN.
+        inline DD settle(double hi, double lo) {
+            if (!std::isfinite(hi)) return { hi, 0 };
+            return quickTwoSum(hi, lo);
+        }
+    }
+
+    inline DD operator-(const DD& a) {
+        return { -a.hi, -a.lo };
+    }
+
+    inline DD operator+(const DD& a, const DD& b) {
+        DD s = DDMath::twoSum(a.hi, b.hi);
+        DD t = DDMath::twoSum(a.lo, b.lo);
+        s.lo += t.hi;
+        s = DDMath::settle(s.hi, s.lo);
+        return DDMath::settle(s.hi, s.lo + t.lo);
+    }
+
+    inline DD operator-(const DD& a, const DD& b) {
+        return a + -b;
+    }
+
+    inline DD operator*(const DD& a, const DD& b) {
+        DD p = DDMath::twoProd(a.hi, b.hi);
+        return DDMath::settle(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+    }
+
+    inline DD operator*(const DD& a, double b) {
+        DD p = DDMath::twoProd(a.hi, b);
+        return DDMath::settle(p.hi, p.lo + a.lo * b);
+    }
+
+    inline DD operator/(const DD& a, const DD& b) {
+        double q1 = a.hi / b.hi;
+        if (!std::isfinite(q1)) return { q1, 0 };
+        DD r = a - b * q1;
+        double q2 = r.hi / b.hi;
+        r = r - b * q2;
+        double q3 = r.hi / b.hi;
+        return DDMath::quickTwoSum(q1, q2) + DD(q3);
+    }
+
+    inline DD& operator+=(DD& a, const DD& b) { return a = a + b; }
+    inline DD& operator-=(DD& a, const DD& b) { return a = a - b; }
+    inline DD& operator*=(DD& a, const DD& b) { return a = a * b; }
+    inline DD& operator/=(DD& a, const DD& b) { return a = a / b; }
+
+    inline bool operator==(const DD& a, const DD& b) { return a.hi == b.hi && a.lo == b.lo; }
+    inline bool operator!=(const DD& a, const DD& b) { return !(a == b); }
+    inline bool operator<(const DD& a, const DD& b) { return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo); }
+    inline bool operator>(const DD& a, const DD& b) { return b < a; }
+    inline bool operator<=(const DD& a, const DD& b) { return !(b < a); }
+    inline bool operator>=(const DD& a, const DD& b) { return !(a < b); }
+
+    inline DD abs(const DD& a) {
+        return a.hi < 0 ? -a : a;
+    }
+
+    inline DD floor(const DD& a) {
+        double hi = std::floor(a.hi);
+        if (hi != a.hi) return DD(hi);
+        return DDMath::quickTwoSum(hi, std::floor(a.lo));
+    }
+
+    // Constants, correctly rounded.
+    constexpr DD DD_PI{ 3.141592653589793116e+00, 1.224646799147353207e-16 };
+    constexpr DD DD_E{ 2.718281828459045091e+00, 1.445646891729250158e-16 };
+    constexpr DD DD_LN2{ 6.931471805599452862e-01, 2.319046813846299558e-17 };
+    constexpr DD DD_PHI{ 1.618033988749894903e+00, -5.432115203682506149e-17 };
+
+    DD sqrt(const DD& a);
+    DD exp(const DD& a);
+    DD log(const DD& a);
+    DD sin(const DD& a);
+    DD cos(const DD& a);
+    DD tan(const DD& a);
+
+    // a^n by repeated squaring.
+    DD pow(const DD& a, long long n);
+    // Integer powers by squaring, others as exp(b log a); a negative base
+    // needs an integer exponent.
+    DD pow(const DD& a, const DD& b);
+}
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <vector>
 #include "../token/token.h"
+#include "../numeric/double_double.h"
 
 namespace Acalc {
 
@@ -11,25 +14,77 @@ namespace Acalc {
             virtual float visitUnaryExpr(class UnaryExpr* expr) = 0;
             virtual float visitBinaryExpr(class BinaryExpr* expr) = 0;
             virtual float visitIntegExpr(class IntegExpr* expr) = 0;
+            virtual float visitMultiIntegExpr(class MultiIntegExpr* expr) = 0;
             virtual float visitIdentifierExpr(class IdentifierExpr* expr) = 0;
     };
 
     class Expr {
         public:
+            virtual ~Expr() = default;
+
             virtual float accept(ExprVisitor* visitor) = 0;
+
+            // Appends this node's operands, left to right.
+            virtual void getChildren(std::vector<Expr*>& out) const {}
+
+            // Moves this node's operands into `out`, leaving it a leaf.
+            virtual void detachChildren(std::vector<std::unique_ptr<Expr>>& out) {}
+
+        protected:
+            // Frees the subtrees below `node` from an explicit work list, so
+            // that destroying a machine-generated expression of any depth
+            // never nests destructor calls.
+            static void destroyChildren(Expr* node) {
+                std::vector<std::unique_ptr<Expr>> pending;
+                node->detachChildren(pending);
+                while (!pending.empty()) {
+                    std::unique_ptr<Expr> child = std::move(pending.back());
+                    pending.pop_back();
+                    child->detachChildren(pending);
+                }
+            }
     };
 
+    // Visits every node of `root` in post-order, operands before the node
+    // that uses them, with an explicit stack instead of recursion.
+    inline void walkPostorder(Expr* root, ExprVisitor* visitor) {
+        std::vector<std::pair<Expr*, bool>> stack{{root, false}};
+        std::vector<Expr*> children;
+
+        while (!stack.empty()) {
+            auto [node, expanded] = stack.back();
+            stack.pop_back();
+
+            if (expanded) {
+                node->accept(visitor);
+                continue;
+            }
+
+            stack.emplace_back(node, true);
+            children.clear();
+            node->getChildren(children);
+            for (auto it = children.rbegin(); it != children.rend(); ++it) {
+                stack.emplace_back(*it, false);
+            }
+        }
+    }
+
+    // A number, kept both as a float and, for `precision dd`, as a
+    // double-double read from the same digits.
     class LiteralExpr : public Expr {
         public:
-            LiteralExpr(float val) : val{val} {}
+            LiteralExpr(float val) : val{val}, exact{val} {}
+            LiteralExpr(float val, const DD& exact) : val{val}, exact{exact} {}
 
             float accept(ExprVisitor* visitor) override {
                 return visitor->visitLiteralExpr(this);
             }
 
             float getValue() const { return val; }
+            const DD& getExact() const { return exact; }
         private:
             float val;
+            DD exact;
     };
 
     class UnaryExpr : public Expr {
@@ -37,11 +92,21 @@ namespace Acalc {
             UnaryExpr(std::unique_ptr<Expr>&& expr, Token op)
             : op{op}, expr{std::move(expr)} {}
 
+            ~UnaryExpr() override { destroyChildren(this); }
+
             float accept(ExprVisitor* visitor) override {
                 return visitor->visitUnaryExpr(this);
             }
 
-            Token getOperator() const { return op; }
+            void getChildren(std::vector<Expr*>& out) const override {
+                out.push_back(expr.get());
+            }
+
+            void detachChildren(std::vector<std::unique_ptr<Expr>>& out) override {
+                if (expr) out.push_back(std::move(expr));
+            }
+
+            const Token& getOperator() const { return op; }
             Expr* getExpr() const { return expr.get(); }
         private:
             Token op;
@@ -53,12 +118,24 @@ namespace Acalc {
             BinaryExpr(std::unique_ptr<Expr>&& left, Token op, std::unique_ptr<Expr>&& right)
             : left{std::move(left)}, op{op}, right{std::move(right)} {}
 
+            ~BinaryExpr() override { destroyChildren(this); }
+
             float accept(ExprVisitor* visitor) override {
                 return visitor->visitBinaryExpr(this);
             }
 
+            void getChildren(std::vector<Expr*>& out) const override {
+                out.push_back(left.get());
+                out.push_back(right.get());
+            }
+
+            void detachChildren(std::vector<std::unique_ptr<Expr>>& out) override {
+                if (left) out.push_back(std::move(left));
+                if (right) out.push_back(std::move(right));
+            }
+
             Expr* getLeft() const { return left.get(); }
-            Token getOperator() const { return op; }
+            const Token& getOperator() const { return op; }
             Expr* getRight() const { return right.get(); }
         private:
             std::unique_ptr<Expr> left;
@@ -71,10 +148,24 @@ namespace Acalc {
             IntegExpr(std::unique_ptr<Expr>&& formula, std::unique_ptr<Expr>&& limit_start, std::unique_ptr<Expr>&& limit_end)
             : formula{std::move(formula)}, limit_start{std::move(limit_start)}, limit_end{std::move(limit_end)} {}
 
+            ~IntegExpr() override { destroyChildren(this); }
+
             float accept(ExprVisitor* visitor) override {
                 return visitor->visitIntegExpr(this);
             }
 
+            void getChildren(std::vector<Expr*>& out) const override {
+                out.push_back(formula.get());
+                out.push_back(limit_start.get());
+                out.push_back(limit_end.get());
+            }
+
+            void detachChildren(std::vector<std::unique_ptr<Expr>>& out) override {
+                if (formula) out.push_back(std::move(formula));
+                if (limit_start) out.push_back(std::move(limit_start));
+                if (limit_end) out.push_back(std::move(limit_end));
+            }
+
             Expr* getFormula() const { return formula.get(); }
             Expr* getLimitStart() const { return limit_start.get(); }
             Expr* getLimitEnd() const { return limit_end.get(); }
@@ -85,6 +176,43 @@ namespace Acalc {
             std::unique_ptr<Expr> limit_end;
     };
 
+    // integ over named variables, each with a lower and an upper limit:
+    // limits[2 * i] and limits[2 * i + 1] belong to variables[i].
+    class MultiIntegExpr : public Expr {
+        public:
+            MultiIntegExpr(std::unique_ptr<Expr>&& formula, std::vector<std::string>&& variables, std::vector<std::unique_ptr<Expr>>&& limits)
+            : formula{std::move(formula)}, variables{std::move(variables)}, limits{std::move(limits)} {}
+
+            ~MultiIntegExpr() override { destroyChildren(this); }
+
+            float accept(ExprVisitor* visitor) override {
+                return visitor->visitMultiIntegExpr(this);
+            }
+
+            void getChildren(std::vector<Expr*>& out) const override {
+                out.push_back(formula.get());
+                for (const auto& limit : limits) {
+                    out.push_back(limit.get());
+                }
+            }
+
+            void detachChildren(std::vector<std::unique_ptr<Expr>>& out) override {
+                if (formula) out.push_back(std::move(formula));
+                for (auto& limit : limits) {
+                    if (limit) out.push_back(std::move(limit));
+                }
+            }
+
+            Expr* getFormula() const { return formula.get(); }
+            const std::vector<std::string>& getVariables() const { return variables; }
+            Expr* getLimit(size_t i) const { return limits[i].get(); }
+
+        private:
+            std::unique_ptr<Expr> formula;
+            std::vector<std::string> variables;
+            std::vector<std::unique_ptr<Expr>> limits;
+    };
+
     class IdentifierExpr : public Expr {
         public:
             IdentifierExpr(const std::string& variable)
@@ -105,6 +233,9 @@ namespace Acalc {
             virtual void visitPrintStmt(class PrintStmt*) = 0;
             virtual void visitVariableStmt(class VariableStmt*) = 0;
             virtual void visitGraphStmt(class GraphStmt*) = 0;
+            virtual void visitPGraphStmt(class PGraphStmt*) = 0;
+            virtual void visitPolarStmt(class PolarStmt*) = 0;
+            virtual void visitImplicitStmt(class ImplicitStmt*) = 0;
             virtual void visitPlotStmt(class PlotStmt*) = 0;
             virtual void visitLineStmt(class LineStmt*) = 0;
             virtual void visitShowStmt(class ShowStmt*) = 0;
@@ -112,10 +243,14 @@ namespace Acalc {
             virtual void visitClearStmt(class ClearStmt*) = 0;
             virtual void visitCleanStmt(class CleanStmt*) = 0;
             virtual void visitExitStmt(class ExitStmt*) = 0;
+            virtual void visitPrecisionStmt(class PrecisionStmt*) = 0;
+            virtual void visitTableStmt(class TableStmt*) = 0;
     };
 
     class Stmt {
         public:
+            virtual ~Stmt() = default;
+
             virtual void accept(StmtVisitor* visitor) = 0;
     };
 
@@ -173,6 +308,60 @@ namespace Acalc {
             std::unique_ptr<Expr> expr;
     };
 
+    // Traces (fx, fy) as t runs from start to end.
+    class PGraphStmt : public Stmt {
+        public:
+            PGraphStmt(std::unique_ptr<Expr>&& fx, std::unique_ptr<Expr>&& fy, std::unique_ptr<Expr>&& start, std::unique_ptr<Expr>&& end)
+            : fx{std::move(fx)}, fy{std::move(fy)}, start{std::move(start)}, end{std::move(end)} {}
+
+            void accept(StmtVisitor* visitor) override {
+                visitor->visitPGraphStmt(this);
+            }
+
+            Expr* getX() { return fx.get(); }
+            Expr* getY() { return fy.get(); }
+            Expr* getStart() { return start.get(); }
+            Expr* getEnd() { return end.get(); }
+        private:
+            std::unique_ptr<Expr> fx;
+            std::unique_ptr<Expr> fy;
+            std::unique_ptr<Expr> start;
+            std::unique_ptr<Expr> end;
+    };
+
+    // Traces the radius r at angle t as t runs from start to end.
+    class PolarStmt : public Stmt {
+        public:
+            PolarStmt(std::unique_ptr<Expr>&& r, std::unique_ptr<Expr>&& start, std::unique_ptr<Expr>&& end)
+            : r{std::move(r)}, start{std::move(start)}, end{std::move(end)} {}
+
+            void accept(StmtVisitor* visitor) override {
+                visitor->visitPolarStmt(this);
+            }
+
+            Expr* getRadius() { return r.get(); }
+            Expr* getStart() { return start.get(); }
+            Expr* getEnd() { return end.get(); }
+        private:
+            std::unique_ptr<Expr> r;
+            std::unique_ptr<Expr> start;
+            std::unique_ptr<Expr> end;
+    };
+
+    // Draws the curve where the expression in x and y is zero.
+    class ImplicitStmt : public Stmt {
+        public:
+            ImplicitStmt(std::unique_ptr<Expr> expr) : expr{std::move(expr)} {}
+
+            void accept(StmtVisitor* visitor) override {
+                visitor->visitImplicitStmt(this);
+            }
+
+            Expr* getExpr() { return expr.get(); }
+        private:
+            std::unique_ptr<Expr> expr;
+    };
+
     class PlotStmt : public Stmt {
         public:
             PlotStmt(std::unique_ptr<Expr>&& a, std::unique_ptr<Expr>&& b)
@@ -244,4 +433,45 @@ namespace Acalc {
                 visitor->visitExitStmt(this);
             }
     };
+
+    enum class Precision : uint8_t { FLOAT, DOUBLE_DOUBLE };
+
+    // Selects the arithmetic used by print, var and expression statements.
+    class PrecisionStmt : public Stmt {
+        public:
+            PrecisionStmt(Precision precision) : precision{precision} {}
+
+            void accept(StmtVisitor* visitor) override {
+                visitor->visitPrecisionStmt(this);
+            }
+
+            Precision getPrecision() const { return precision; }
+        private:
+            Precision precision;
+    };
+
+    // Writes "x,value" rows for x from start to end in steps of step, to
+    // the file at `path`, or to the interpreter's output if it is empty.
+    class TableStmt : public Stmt {
+        public:
+            TableStmt(std::unique_ptr<Expr>&& expr, std::unique_ptr<Expr>&& start, std::unique_ptr<Expr>&& end,
+                      std::unique_ptr<Expr>&& step, std::string path)
+            : expr{std::move(expr)}, start{std::move(start)}, end{std::move(end)}, step{std::move(step)}, path{std::move(path)} {}
+
+            void accept(StmtVisitor* visitor) override {
+                visitor->visitTableStmt(this);
+            }
+
+            Expr* getExpr() { return expr.get(); }
+            Expr* getStart() { return start.get(); }
+            Expr* getEnd() { return end.get(); }
+            Expr* getStep() { return step.get(); }
+            const std::string& getPath() const { return path; }
+        private:
+            std::unique_ptr<Expr> expr;
+            std::unique_ptr<Expr> start;
+            std::unique_ptr<Expr> end;
+            std::unique_ptr<Expr> step;
+            std::string path;
+    };
 }
@@ -1,22 +1,52 @@
 #include "parser.h"
 #include "expr.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
 #include <iostream>
+#include <stdexcept>
 
+// Statements are parsed by recursive descent, one method each:
+//
 // parse        -> statement* EOF
-// forStmt      -> "for" "(" (varDecl | exprStmt | ";") expression? ";" expression? ")" statement
-// statement    -> exprStmt | printStmt | graphStmt | varDecl | plotStmt | lineStmt |
+// statement    -> exprStmt | printStmt | graphStmt | pgraphStmt | polarStmt | implicitStmt |
+//                  varDecl | plotStmt | lineStmt | precisionStmt | tableStmt |
 //                  ("show" | "hide" | "clear" | "clean" | "exit") ";"
 // exprStmt     -> expr ";"
-// graphStmt    -> "graph" term ";"
+// graphStmt    -> "graph" expr ";"
+// pgraphStmt   -> "pgraph" expr "," expr "," expr "," expr ";"
+// polarStmt    -> "polar" expr "," expr "," expr ";"
+// implicitStmt -> "implicit" expr ";"
 // printStmt    -> "print" expr ";"
-// varDecl      -> "var" IDENTIFIER ( "=" expression )? ";"
-// plotStmt     -> "plot" expr "," expr";"
+// varDecl      -> "var" IDENTIFIER ( "=" expr )? ";"
+// plotStmt     -> "plot" expr "," expr ";"
 // lineStmt     -> "line" expr "," expr "," expr "," expr ";"
-// expr         -> term | "integ" "(" term "," term "," term ")"
-// term         -> factor (("-" | "+") factor)*;
-// factor       -> UnaryExpr (("*" | "/") UnaryExpr)*
-// unary        -> ("+" | "-" | "sin") unary | primary
-// primary      -> num | identifier | "(" expr ")"
+// precisionStmt -> "precision" ("float" | "dd") ";"
+// tableStmt    -> "table" expr "," expr "," expr "," expr ("into" STRING)? ";"
+//
+// Expressions are parsed by precedence climbing in a single loop, over an
+// operand stack and a stack of pending operators and brackets:
+//
+// expr         -> prefix* operand (binary prefix* operand)*
+// prefix       -> "+" | "-" | "sin" | "cos" | "tan" | "cosec" | "sec" | "cot" | "log" | "abs"
+// operand      -> NUMBER | IDENTIFIER | "(" expr ")" |
+//                  "integ" "(" expr "," expr "," expr ")" |
+//                  "integ" "(" expr ("," IDENTIFIER "," expr "," expr)+ ")"
+// binary       -> "+" | "-" | "*" | "/" | "^"
+//
+// Binding powers, loosest first (see Precedence):
+//
+//   PREC_TERM    + -       left-associative
+//   PREC_FACTOR  * /       left-associative
+//   PREC_UNARY   prefixes  apply to a whole power, so -2^2 is -(2^2)
+//   PREC_POWER   ^         right-associative
+//
+// Each pass of the loop pushes the prefixes, then an operand or an opening
+// bracket. After an operand, an incoming binary operator first reduces the
+// pending operators that bind tighter than it, then is pushed. Anything
+// else closes the innermost bracket: the operators above it are reduced,
+// and a comma counts an integ argument while ")" builds the group or the
+// integ. With no bracket left the expression is complete.
 
 namespace Acalc {
 
@@ -29,8 +59,13 @@ namespace Acalc {
         if (match(TOKEN_PRINT)) return printStmt();
         if (match(TOKEN_VAR)) return varDecl();
         if (match(TOKEN_GRAPH)) return graphStmt();
+        if (match(TOKEN_PGRAPH)) return pgraphStmt();
+        if (match(TOKEN_POLAR)) return polarStmt();
+        if (match(TOKEN_IMPLICIT)) return implicitStmt();
         if (match(TOKEN_PLOT)) return plotStmt();
         if (match(TOKEN_LINE)) return lineStmt();
+        if (match(TOKEN_PRECISION)) return precisionStmt();
+        if (match(TOKEN_TABLE)) return tableStmt();
         if (match(TOKEN_SHOW)) {
             consume(TOKEN_SEMICOLON, "Expected ';' after 'show'.");
             return std::make_unique<ShowStmt>();
@@ -83,6 +118,34 @@ namespace Acalc {
         return std::make_unique<GraphStmt>(std::move(expr));
     }
 
+    std::unique_ptr<Stmt> Parser::pgraphStmt() {
+        auto fx = expression();
+        consume(TOKEN_COMMA, "Expected ',' after first expression.");
+        auto fy = expression();
+        consume(TOKEN_COMMA, "Expected ',' after second expression.");
+        auto start = expression();
+        consume(TOKEN_COMMA, "Expected ',' after third expression.");
+        auto end = expression();
+        consume(TOKEN_SEMICOLON, "forgot ';'?");
+        return std::make_unique<PGraphStmt>(std::move(fx), std::move(fy), std::move(start), std::move(end));
+    }
+
+    std::unique_ptr<Stmt> Parser::polarStmt() {
+        auto r = expression();
+        consume(TOKEN_COMMA, "Expected ',' after first expression.");
+        auto start = expression();
+        consume(TOKEN_COMMA, "Expected ',' after second expression.");
+        auto end = expression();
+        consume(TOKEN_SEMICOLON, "forgot ';'?");
+        return std::make_unique<PolarStmt>(std::move(r), std::move(start), std::move(end));
+    }
+
+    std::unique_ptr<Stmt> Parser::implicitStmt() {
+        auto expr = expression();
+        consume(TOKEN_SEMICOLON, "forgot ';'?");
+        return std::make_unique<ImplicitStmt>(std::move(expr));
+    }
+
     std::unique_ptr<Stmt> Parser::plotStmt() {
         auto a = expression();
         consume(TOKEN_COMMA, "Expected ',' after first expression.");
@@ -103,66 +166,209 @@ namespace Acalc {
         return std::make_unique<LineStmt>(std::move(a), std::move(b), std::move(c), std::move(d));
     }
 
-    std::unique_ptr<Expr> Parser::expression() {
-        if (match(TOKEN_INTEG)) {
-            consume(TOKEN_LEFT_PAREN, "expected a '('");
-            auto formula = term();
-            consume(TOKEN_COMMA, "expected a ','");
-            auto limit_start = term();
-            consume(TOKEN_COMMA, "expected a ','");
-            auto limit_end = term();
-            consume(TOKEN_RIGHT_PAREN, "expected a ')'");
-            return std::make_unique<IntegExpr>(std::move(formula), std::move(limit_start), std::move(limit_end));
+    std::unique_ptr<Stmt> Parser::precisionStmt() {
+        consume(TOKEN_IDENTIFIER, "Expected 'float' or 'dd' after 'precision'.");
+        Precision precision;
+        if (previous().lexeme == "float") {
+            precision = Precision::FLOAT;
+        } else if (previous().lexeme == "dd") {
+            precision = Precision::DOUBLE_DOUBLE;
+        } else {
+            throw "Expected 'float' or 'dd' after 'precision'.";
         }
-        return term();
+        consume(TOKEN_SEMICOLON, "forgot ';'?");
+        return std::make_unique<PrecisionStmt>(precision);
     }
 
-    std::unique_ptr<Expr> Parser::term() {
-        auto left = factor();
-        while (match(TOKEN_MINUS, TOKEN_PLUS)) {
-            auto op = previous();
-            auto right = factor();
-            left = std::make_unique<BinaryExpr>(std::move(left), op, std::move(right));
+    std::unique_ptr<Stmt> Parser::tableStmt() {
+        auto expr = expression();
+        consume(TOKEN_COMMA, "Expected ',' after first expression.");
+        auto start = expression();
+        consume(TOKEN_COMMA, "Expected ',' after second expression.");
+        auto end = expression();
+        consume(TOKEN_COMMA, "Expected ',' after third expression.");
+        auto step = expression();
+        std::string path;
+        if (match(TOKEN_INTO)) {
+            consume(TOKEN_STRING, "Expected a quoted file name after 'into'.");
+            path = previous().lexeme;
+            if (path.empty()) throw "Expected a quoted file name after 'into'.";
         }
-        return left;
+        consume(TOKEN_SEMICOLON, "forgot ';'?");
+        return std::make_unique<TableStmt>(std::move(expr), std::move(start), std::move(end), std::move(step), std::move(path));
     }
 
-    std::unique_ptr<Expr> Parser::factor() {
-        auto left = unary();
-        while (match(TOKEN_STAR, TOKEN_SLASH, TOKEN_POWER)) {
-            auto op = previous();
-            auto right = unary();
-            left = std::make_unique<BinaryExpr>(std::move(left), op, std::move(right));
+    namespace {
+
+        enum Precedence {
+            PREC_NONE,
+            PREC_TERM,      // + -
+            PREC_FACTOR,    // * /
+            PREC_UNARY,     // - + sin cos tan cosec sec cot log abs
+            PREC_POWER      // ^ (right-associative)
+        };
+
+        Precedence binaryPrecedence(TokenType type) {
+            switch (type) {
+                case TOKEN_PLUS:
+                case TOKEN_MINUS: return PREC_TERM;
+                case TOKEN_STAR:
+                case TOKEN_SLASH: return PREC_FACTOR;
+                case TOKEN_POWER: return PREC_POWER;
+                default: return PREC_NONE;
+            }
         }
-        return left;
-    }
 
-    std::unique_ptr<Expr> Parser::unary() {
-        if (match(TOKEN_MINUS, TOKEN_PLUS, TOKEN_SIN, TOKEN_COS, TOKEN_TAN, TOKEN_COSEC, TOKEN_SEC, TOKEN_COT, TOKEN_LOG, TOKEN_ABS)) {
-            auto op = previous();
-            auto expr = unary();
-            return std::make_unique<UnaryExpr>(std::move(expr), op);
+        // An operator or bracket on the parser's stack, waiting for its operands.
+        struct Pending {
+            enum Kind { PREFIX, BINARY, GROUP, INTEG } kind;
+            Token op;
+            int args;
+
+            bool isBracket() const { return kind == GROUP || kind == INTEG; }
+
+            // Whether this operator takes its right operand before an
+            // incoming binary operator of precedence `prec` does.
+            bool bindsTighter(Precedence prec) const {
+                switch (kind) {
+                    case PREFIX: return PREC_UNARY >= prec;
+                    case BINARY: {
+                        Precedence own = binaryPrecedence(op.type);
+                        return own > prec || (own == prec && prec != PREC_POWER);
+                    }
+                    default: return false;
+                }
+            }
+        };
+
+        // A number literal, read both as a float and as a double-double.
+        // Past the float range the float half saturates like float
+        // arithmetic does, so `precision dd` still gets every digit.
+        std::unique_ptr<Expr> literal(const std::string& digits) {
+            DD exact = DD::parse(digits);
+            if (std::isinf(exact.hi)) {
+                throw std::runtime_error("Error: number out of range: " + digits);
+            }
+            float val = 0;
+            auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), val);
+            if (ec == std::errc::result_out_of_range) {
+                val = static_cast<float>(exact.hi);
+            }
+            return std::make_unique<LiteralExpr>(val, exact);
         }
-        return primary();
     }
 
-    std::unique_ptr<Expr> Parser::primary() {
-        if (match(TOKEN_NUMBER)) {
-            float val = std::stof(previous().lexeme);
-            return std::make_unique<LiteralExpr>(val);
-        }
+    // Precedence climbing over explicit operand and operator stacks, so
+    // neither deep nesting nor long prefix chains grow the call stack.
+    std::unique_ptr<Expr> Parser::expression() {
+        std::vector<std::unique_ptr<Expr>> operands;
+        std::vector<Pending> pending;
 
-        if (match(TOKEN_IDENTIFIER)) {
-            return std::make_unique<IdentifierExpr>(previous().lexeme);
-        }
+        auto pop = [&operands]() {
+            auto expr = std::move(operands.back());
+            operands.pop_back();
+            return expr;
+        };
+
+        auto reduce = [&]() {
+            Pending top = std::move(pending.back());
+            pending.pop_back();
+            auto right = pop();
+            if (top.kind == Pending::PREFIX) {
+                operands.push_back(std::make_unique<UnaryExpr>(std::move(right), top.op));
+            } else {
+                auto left = pop();
+                operands.push_back(std::make_unique<BinaryExpr>(std::move(left), top.op, std::move(right)));
+            }
+        };
+
+        auto reduceToBracket = [&]() {
+            while (!pending.empty() && !pending.back().isBracket()) {
+                reduce();
+            }
+        };
+
+        while (true) {
+            while (match(TOKEN_MINUS, TOKEN_PLUS, TOKEN_SIN, TOKEN_COS, TOKEN_TAN, TOKEN_COSEC, TOKEN_SEC, TOKEN_COT, TOKEN_LOG, TOKEN_ABS)) {
+                pending.push_back({ Pending::PREFIX, previous(), 0 });
+            }
+
+            if (match(TOKEN_NUMBER)) {
+                operands.push_back(literal(previous().lexeme));
+            } else if (match(TOKEN_IDENTIFIER)) {
+                operands.push_back(std::make_unique<IdentifierExpr>(previous().lexeme));
+            } else if (match(TOKEN_LEFT_PAREN)) {
+                pending.push_back({ Pending::GROUP, previous(), 0 });
+                continue;
+            } else if (match(TOKEN_INTEG)) {
+                consume(TOKEN_LEFT_PAREN, "expected a '('");
+                pending.push_back({ Pending::INTEG, previous(), 0 });
+                continue;
+            } else {
+                throw "unrecognised character encountered.";
+            }
+
+            while (true) {
+                if (Precedence prec = binaryPrecedence(peek().type)) {
+                    advance();
+                    while (!pending.empty() && pending.back().bindsTighter(prec)) {
+                        reduce();
+                    }
+                    pending.push_back({ Pending::BINARY, previous(), 0 });
+                    break;
+                }
+
+                reduceToBracket();
+
+                if (pending.empty()) {
+                    return pop();
+                }
+
+                Pending& bracket = pending.back();
+
+                if (bracket.kind == Pending::INTEG && match(TOKEN_COMMA)) {
+                    ++bracket.args;
+                    break;
+                }
 
-        if (match(TOKEN_LEFT_PAREN)) {
-            auto expr = expression();
-            if (match(TOKEN_RIGHT_PAREN)) {
-                return expr;
+                if (bracket.kind == Pending::INTEG && bracket.args == 2) {
+                    consume(TOKEN_RIGHT_PAREN, "expected a ')'");
+                    auto limit_end = pop();
+                    auto limit_start = pop();
+                    auto formula = pop();
+                    operands.push_back(std::make_unique<IntegExpr>(std::move(formula), std::move(limit_start), std::move(limit_end)));
+                } else if (bracket.kind == Pending::INTEG) {
+                    // A variable and its two limits per dimension.
+                    consume(TOKEN_RIGHT_PAREN, "expected a ')'");
+                    if (bracket.args == 0 || bracket.args % 3 != 0) {
+                        throw "integ takes an expression and two limits, or a variable and two limits per dimension";
+                    }
+                    size_t dimensions = bracket.args / 3;
+                    std::vector<std::string> variables(dimensions);
+                    std::vector<std::unique_ptr<Expr>> limits(2 * dimensions);
+                    for (size_t i = dimensions; i-- > 0;) {
+                        limits[2 * i + 1] = pop();
+                        limits[2 * i] = pop();
+                        auto variable = pop();
+                        auto* name = dynamic_cast<IdentifierExpr*>(variable.get());
+                        if (name == nullptr) {
+                            throw "expected a variable name in integ";
+                        }
+                        variables[i] = name->getVariable();
+                    }
+                    for (size_t i = 0; i < dimensions; ++i) {
+                        if (std::count(variables.begin(), variables.end(), variables[i]) > 1) {
+                            throw "integ variables must be distinct";
+                        }
+                    }
+                    auto formula = pop();
+                    operands.push_back(std::make_unique<MultiIntegExpr>(std::move(formula), std::move(variables), std::move(limits)));
+                } else {
+                    consume(TOKEN_RIGHT_PAREN, "unrecognised character encountered.");
+                }
+                pending.pop_back();
             }
         }
-        throw "unrecognised character encountered.";
     }
 
     bool Parser::match(TokenType type) {
@@ -1,15 +1,17 @@
 #pragma once
 
-#include <vector>
 #include <memory>
 #include "../token/token.h"
+#include "../lexer/lexer.h"
 #include "expr.h"
 
 namespace Acalc {
 
+    // Pulls tokens from the lexer one at a time, so only the statement being
+    // parsed is ever held in memory.
     class Parser {
         public:
-            Parser(const std::vector<Token>& tokens) : tokens{tokens}, cur{} {}
+            Parser(Lexer& lexer) : lexer{lexer}, current{lexer.getNextToken()}, prev{TOKEN_EOF, ""} {}
 
             std::unique_ptr<Stmt> parse();
 
@@ -19,20 +21,21 @@ namespace Acalc {
             std::unique_ptr<Stmt> printStmt();
             std::unique_ptr<Stmt> varDecl();
             std::unique_ptr<Stmt> graphStmt();
+            std::unique_ptr<Stmt> pgraphStmt();
+            std::unique_ptr<Stmt> polarStmt();
+            std::unique_ptr<Stmt> implicitStmt();
             std::unique_ptr<Stmt> plotStmt();
             std::unique_ptr<Stmt> lineStmt();
+            std::unique_ptr<Stmt> precisionStmt();
+            std::unique_ptr<Stmt> tableStmt();
 
             std::unique_ptr<Expr> expression();
-            std::unique_ptr<Expr> term();
-            std::unique_ptr<Expr> factor();
-            std::unique_ptr<Expr> unary();
-            std::unique_ptr<Expr> primary();
 
             void consume(TokenType type, const char* msg);
-            bool isAtEnd() const { return cur >= tokens.size() || peek().type == TOKEN_EOF; }
-            const Token& peek() const { return tokens[cur]; }
-            void advance() { ++cur; }
-            Token previous() { return tokens[cur-1]; }
+            bool isAtEnd() const { return peek().type == TOKEN_EOF; }
+            const Token& peek() const { return current; }
+            void advance() { prev = std::move(current); current = lexer.getNextToken(); }
+            const Token& previous() const { return prev; }
 
             bool match(TokenType type);
 
@@ -42,7 +45,8 @@ namespace Acalc {
             }
 
         private:
-            std::vector<Token> tokens;
-            size_t cur;
+            Lexer& lexer;
+            Token current;
+            Token prev;
     };
 }
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace Acalc {
+
+    // Wire format of the evaluation server. Every message is a frame: a
+    // 4-byte little-endian payload length followed by the payload.
+    //
+    //   request payload:  script source, run in the connection's session
+    //   response payload: 1 status byte, then everything the script printed
+    //                     (including the error message when it failed)
+    //
+    // Requests may be pipelined; responses come back in request order.
+    namespace Protocol {
+
+        constexpr uint32_t MAX_FRAME = 16 << 20;
+
+        enum Status : uint8_t { OK = 0, FAILED = 1 };
+
+        inline void appendHeader(std::string& out, uint32_t length) {
+            for (int i = 0; i < 4; ++i) {
+                out += static_cast<char>((length >> (8 * i)) & 0xff);
+            }
+        }
+
+        inline void appendFrame(std::string& out, std::string_view payload) {
+            appendHeader(out, static_cast<uint32_t>(payload.size()));
+            out.append(payload);
+        }
+
+        inline void appendResponse(std::string& out, Status status, std::string_view text) {
+            appendHeader(out, static_cast<uint32_t>(text.size() + 1));
+            out += static_cast<char>(status);
+            out.append(text);
+        }
+
+        enum Parse { COMPLETE, INCOMPLETE, TOO_LARGE };
+
+        // Looks for a whole frame at the start of `in`. On COMPLETE,
+        // `payload` views it and `consumed` is the frame's full size.
+        inline Parse nextFrame(std::string_view in, std::string_view& payload, size_t& consumed) {
+            if (in.size() < 4) return INCOMPLETE;
+
+            uint32_t length = 0;
+            for (int i = 0; i < 4; ++i) {
+                length |= static_cast<uint32_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+            }
+            if (length > MAX_FRAME) return TOO_LARGE;
+            if (in.size() - 4 < length) return INCOMPLETE;
+
+            payload = in.substr(4, length);
+            consumed = 4 + static_cast<size_t>(length);
+            return COMPLETE;
+        }
+    }
+}
@@ -0,0 +1,336 @@
+#include "server.h"
+#include "protocol.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace Acalc {
+
+    namespace {
+
+        std::runtime_error failure(const std::string& what) {
+            return std::runtime_error("Error: " + what + ": " + std::strerror(errno));
+        }
+
+        void subscribe(int epoll, int fd, uint32_t events, int op = EPOLL_CTL_ADD) {
+            epoll_event ev{};
+            ev.events = events;
+            ev.data.fd = fd;
+            if (epoll_ctl(epoll, op, fd, &ev) < 0) {
+                throw failure("epoll_ctl");
+            }
+        }
+    }
+
+    Server::Server(const std::string& path, size_t count) : path{path} {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof addr.sun_path) {
+            throw std::runtime_error("Error: socket path too long: " + path);
+        }
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+        try {
+            listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (listener < 0) throw failure("socket");
+
+            ::unlink(path.c_str());
+            if (::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0 || ::listen(listener, SOMAXCONN) < 0) {
+                throw failure("cannot listen on " + path);
+            }
+
+            epoll = epoll_create1(EPOLL_CLOEXEC);
+            if (epoll < 0) throw failure("epoll_create1");
+            events = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (events < 0) throw failure("eventfd");
+
+            subscribe(epoll, listener, EPOLLIN);
+            subscribe(epoll, events, EPOLLIN);
+            spare = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        } catch (...) {
+            release();
+            throw;
+        }
+
+        if (count == 0) {
+            count = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (size_t i = 0; i < count; ++i) {
+            workers.emplace_back([this]() { work(); });
+        }
+    }
+
+    Server::~Server() {
+        stop();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        for (auto& [fd, conn] : connections) {
+            ::close(fd);
+        }
+        release();
+    }
+
+    void Server::release() {
+        if (spare >= 0) ::close(spare);
+        if (events >= 0) ::close(events);
+        if (epoll >= 0) ::close(epoll);
+        if (listener >= 0) {
+            ::close(listener);
+            ::unlink(path.c_str());
+        }
+    }
+
+    void Server::stop() {
+        {
+            std::lock_guard<std::mutex> lock(jobsMutex);
+            stopping = true;
+        }
+        jobsReady.notify_all();
+        wake();
+    }
+
+    void Server::wake() {
+        uint64_t one = 1;
+        [[maybe_unused]] ssize_t n = ::write(events, &one, sizeof one);
+    }
+
+    void Server::run() {
+        epoll_event ready[64];
+
+        while (!stopping) {
+            int n = epoll_wait(epoll, ready, 64, -1);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw failure("epoll_wait");
+            }
+
+            for (int i = 0; i < n; ++i) {
+                int fd = ready[i].data.fd;
+
+                if (fd == listener) {
+                    accept();
+                } else if (fd == events) {
+                    uint64_t count;
+                    [[maybe_unused]] ssize_t r = ::read(events, &count, sizeof count);
+                    complete();
+                } else {
+                    auto it = connections.find(fd);
+                    if (it == connections.end()) continue;
+                    std::shared_ptr<Connection> conn = it->second;
+
+                    uint32_t ev = ready[i].events;
+                    // A hung-up client that is no longer read from could
+                    // not take its responses anyway.
+                    if ((ev & EPOLLERR) || ((ev & EPOLLHUP) && (conn->closing || throttled(*conn)))) {
+                        close(conn);
+                        continue;
+                    }
+                    if (ev & (EPOLLIN | EPOLLHUP)) {
+                        receive(conn);
+                    }
+                    if (!conn->closed && (ev & EPOLLOUT)) {
+                        send(conn);
+                    }
+                }
+            }
+        }
+    }
+
+    void Server::accept() {
+        while (true) {
+            int fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                if (errno == EMFILE || errno == ENFILE) {
+                    // A waiting client keeps the listener readable, so
+                    // turn it away with the spare descriptor, or stop
+                    // listening until a connection closes. The error comes
+                    // before the queue is checked, so there may be none.
+                    if (spare >= 0) {
+                        ::close(spare);
+                        int dropped = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+                        if (dropped >= 0) ::close(dropped);
+                        spare = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+                        if (dropped >= 0) continue;
+                        return;
+                    }
+                    listen(false);
+                }
+                return;
+            }
+
+            subscribe(epoll, fd, EPOLLIN);
+            connections[fd] = std::make_shared<Connection>(fd);
+        }
+    }
+
+    // Reads until the socket is drained or the connection's queues are
+    // full, splitting frames as they complete.
+    void Server::receive(const std::shared_ptr<Connection>& conn) {
+        char buffer[64 * 1024];
+
+        while (!throttled(*conn)) {
+            ssize_t n = ::read(conn->fd, buffer, sizeof buffer);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (n < 0) {
+                close(conn);
+                return;
+            }
+            if (n == 0) {
+                // The client has finished sending; answer what it already sent.
+                conn->closing = true;
+                break;
+            }
+            conn->in.append(buffer, static_cast<size_t>(n));
+
+            std::string_view rest = conn->in;
+            std::string_view payload;
+            size_t consumed = 0;
+            while (true) {
+                Protocol::Parse parse = Protocol::nextFrame(rest, payload, consumed);
+                if (parse == Protocol::TOO_LARGE) {
+                    close(conn);
+                    return;
+                }
+                if (parse == Protocol::INCOMPLETE) break;
+                conn->pending.emplace_back(payload);
+                conn->queued += payload.size();
+                rest.remove_prefix(consumed);
+            }
+            conn->in.erase(0, conn->in.size() - rest.size());
+        }
+
+        dispatch(conn);
+    }
+
+    // Hands the connection's next request to the workers, unless one is
+    // already running or the client is behind on reading responses, and
+    // closes the connection once nothing is left.
+    void Server::dispatch(const std::shared_ptr<Connection>& conn) {
+        if (conn->closed) return;
+
+        if (!conn->busy && !conn->pending.empty() && conn->out.size() < OUTPUT_LIMIT) {
+            conn->busy = true;
+            conn->queued -= conn->pending.front().size();
+            {
+                std::lock_guard<std::mutex> lock(jobsMutex);
+                jobs.push_back({ conn, std::move(conn->pending.front()) });
+            }
+            conn->pending.pop_front();
+            jobsReady.notify_one();
+        } else if (!conn->busy && conn->pending.empty() && conn->closing && conn->out.empty()) {
+            close(conn);
+            return;
+        }
+        watch(conn);
+    }
+
+    void Server::send(const std::shared_ptr<Connection>& conn) {
+        size_t sent = 0;
+        while (sent < conn->out.size()) {
+            ssize_t n = ::send(conn->fd, conn->out.data() + sent, conn->out.size() - sent, MSG_NOSIGNAL);
+            if (n > 0) {
+                sent += static_cast<size_t>(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            close(conn);
+            return;
+        }
+        conn->out.erase(0, sent);
+        dispatch(conn);
+    }
+
+    // Reads while the connection can take more requests and waits for
+    // writability while a response is only partly sent.
+    void Server::watch(const std::shared_ptr<Connection>& conn) {
+        uint32_t interest = (conn->closing || throttled(*conn) ? 0u : EPOLLIN) | (conn->out.empty() ? 0u : EPOLLOUT);
+        if (interest == conn->interest) return;
+        conn->interest = interest;
+        subscribe(epoll, conn->fd, interest, EPOLL_CTL_MOD);
+    }
+
+    void Server::listen(bool on) {
+        if (on == listening) return;
+        listening = on;
+        subscribe(epoll, listener, on ? EPOLLIN : 0u, EPOLL_CTL_MOD);
+    }
+
+    void Server::close(const std::shared_ptr<Connection>& conn) {
+        if (conn->closed) return;
+        conn->closed = true;
+        epoll_ctl(epoll, EPOLL_CTL_DEL, conn->fd, nullptr);
+        ::close(conn->fd);
+        connections.erase(conn->fd);
+
+        // A descriptor is free again.
+        if (spare < 0) spare = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        listen(true);
+    }
+
+    // Runs on the I/O thread when workers have posted results.
+    void Server::complete() {
+        std::vector<Result> done;
+        {
+            std::lock_guard<std::mutex> lock(resultsMutex);
+            done.swap(results);
+        }
+
+        for (Result& result : done) {
+            const std::shared_ptr<Connection>& conn = result.conn;
+            if (conn->closed) continue;
+
+            conn->busy = false;
+            conn->out += result.response;
+            if (result.exited) {
+                conn->pending.clear();
+                conn->queued = 0;
+                conn->closing = true;
+            }
+            send(conn);
+        }
+    }
+
+    void Server::work() {
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(jobsMutex);
+                jobsReady.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (stopping) return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            // Only this worker touches the session until the result is posted.
+            Connection& conn = *job.conn;
+            conn.output.str("");
+            conn.output.clear();
+            bool ok = false;
+            try {
+                ok = conn.session.run(job.request);
+            } catch (...) {
+                // A client's script must never take the server down with it.
+                conn.output << "Error: request failed" << std::endl;
+            }
+
+            Result result{ job.conn, {}, conn.session.exited() };
+            Protocol::appendResponse(result.response, ok ? Protocol::OK : Protocol::FAILED, conn.output.str());
+            {
+                std::lock_guard<std::mutex> lock(resultsMutex);
+                results.push_back(std::move(result));
+            }
+            wake();
+        }
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/epoll.h>
+#include "../session/session.h"
+
+namespace Acalc {
+
+    // Local evaluation server on a Unix domain socket (Linux only).
+    //
+    // One I/O thread runs an epoll loop over non-blocking sockets: it
+    // accepts clients, splits their input into request frames and writes
+    // responses back (see protocol.h). Every connection has its own
+    // Session, so variables persist between its requests. Requests are run
+    // on a pool of worker threads; a connection has at most one request
+    // running at a time, which keeps its responses in order and its session
+    // on one thread, while different connections run in parallel. The pool
+    // already has a thread per core, so each session's statements run on
+    // their pool thread alone rather than starting workers of their own.
+    // Any client can connect to the socket, so its scripts cannot write
+    // files with `table ... into`. A client that sends faster than it reads
+    // stops being read (and served) until its queues drain.
+    class Server {
+        public:
+            // Binds `path`, replacing a stale socket file. Throws
+            // std::runtime_error on failure.
+            explicit Server(const std::string& path, size_t workers = 0);
+            Server(const Server&) = delete;
+            Server& operator=(const Server&) = delete;
+            ~Server();
+
+            // Serves until stop() is called.
+            void run();
+
+            // Makes run() return. Safe to call from any thread.
+            void stop();
+
+        private:
+            struct Connection {
+                int fd;
+                std::ostringstream output;
+                Session session{ output, nullptr, options() };
+
+                // Touched by the I/O thread only.
+                std::string in;
+                std::string out;
+                std::deque<std::string> pending;
+                size_t queued = 0;
+                uint32_t interest = EPOLLIN;
+                bool busy = false;
+                bool closing = false;
+                bool closed = false;
+
+                explicit Connection(int fd) : fd{fd} {}
+            };
+
+            static InterpreterOptions options() {
+                InterpreterOptions options;
+                options.workers = 1;
+                options.files = false;
+                return options;
+            }
+
+            // Past these a connection is no longer read from: requests
+            // waiting to run, in bytes and in count, and responses the
+            // client has not read yet, in bytes.
+            static constexpr size_t QUEUE_LIMIT = 16 << 20;
+            static constexpr size_t BACKLOG_LIMIT = 256;
+            static constexpr size_t OUTPUT_LIMIT = 4 << 20;
+
+            static bool throttled(const Connection& conn) {
+                return conn.queued >= QUEUE_LIMIT || conn.pending.size() >= BACKLOG_LIMIT || conn.out.size() >= OUTPUT_LIMIT;
+            }
+
+            struct Job {
+                std::shared_ptr<Connection> conn;
+                std::string request;
+            };
+
+            struct Result {
+                std::shared_ptr<Connection> conn;
+                std::string response;
+                bool exited;
+            };
+
+            void accept();
+            void receive(const std::shared_ptr<Connection>& conn);
+            void send(const std::shared_ptr<Connection>& conn);
+            void dispatch(const std::shared_ptr<Connection>& conn);
+            void watch(const std::shared_ptr<Connection>& conn);
+            void close(const std::shared_ptr<Connection>& conn);
+            void listen(bool on);
+            void complete();
+            void work();
+            void wake();
+            void release();
+
+        private:
+            std::string path;
+            int listener = -1;
+            int epoll = -1;
+            int events = -1;
+            // Held open so accept() can still take and drop a client when
+            // the process runs out of descriptors.
+            int spare = -1;
+            bool listening = true;
+
+            std::unordered_map<int, std::shared_ptr<Connection>> connections;
+
+            std::mutex jobsMutex;
+            std::condition_variable jobsReady;
+            std::deque<Job> jobs;
+
+            std::mutex resultsMutex;
+            std::vector<Result> results;
+
+            std::atomic<bool> stopping{ false };
+            std::vector<std::thread> workers;
+    };
+}
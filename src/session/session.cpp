@@ -0,0 +1,110 @@
+#include "session.h"
+#include <fstream>
+#include <stdexcept>
+#include "../lexer/lexer.h"
+#include "../parser/parser.h"
+#include "../cache/script_cache.h"
+
+namespace Acalc {
+
+    // Runs statements from `next` until it runs out, a statement fails or
+    // the script exits, then draws whatever a throttled redefinition left
+    // pending. Callers reset the progress first.
+    template <typename Source>
+    bool Session::execute(Source&& next) {
+        bool ok = true;
+        auto guard = [this, &ok](auto&& body) {
+            try {
+                body();
+            } catch (const std::runtime_error& e) {
+                ok = report(e.what());
+            } catch (const std::string& err) {
+                ok = report(err);
+            } catch (const char* err) {
+                ok = report(err);
+            } catch (const std::exception& e) {
+                ok = report(std::string("Error: ") + e.what());
+            } catch (...) {
+                ok = report("Error: unexpected failure");
+            }
+        };
+
+        guard([this, &next]() {
+            std::unique_ptr<Stmt> stmt = nullptr;
+            while (!interpreter.exited() && (stmt = next()) != nullptr) {
+                interpreter.interpret(stmt);
+            }
+        });
+        guard([this]() { interpreter.flush(); });
+        return ok;
+    }
+
+    bool Session::report(const std::string& message) {
+        out << message << std::endl;
+        return false;
+    }
+
+    bool Session::run(std::string_view code) {
+        prepare();
+        return runPrepared(code);
+    }
+
+    bool Session::runPrepared(std::string_view code) {
+        Lexer lexer(code);
+        Parser parser(lexer);
+        return execute([&parser]() { return parser.parse(); });
+    }
+
+    bool Session::run(std::istream& code) {
+        prepare();
+        Lexer lexer(code);
+        Parser parser(lexer);
+        return execute([&parser]() { return parser.parse(); });
+    }
+
+    bool Session::runFile(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+
+        if (!file.is_open()) {
+            return report("Couldn't read file " + path + ".");
+        }
+
+        uint64_t hash = fnv1a(file);
+        std::string cachePath = ScriptCache::pathFor(path);
+
+        ScriptCache cache;
+        if (!cache.open(cachePath, hash)) {
+            file.clear();
+            file.seekg(0);
+            if (!ScriptCache::build(file, hash, cachePath) || !cache.open(cachePath, hash)) {
+                file.clear();
+                file.seekg(0);
+                return run(file);
+            }
+        }
+
+        prepare();
+        return execute([&cache]() { return cache.next(); });
+    }
+
+    float Session::evaluate(std::string_view expression) {
+        std::string code(expression);
+        code += ';';
+        prepare();
+
+        try {
+            Lexer lexer(code);
+            Parser parser(lexer);
+            std::unique_ptr<Stmt> stmt = parser.parse();
+            auto* es = dynamic_cast<ExprStmt*>(stmt.get());
+            if (es == nullptr || parser.parse() != nullptr) {
+                throw std::runtime_error("Error: expected a single expression");
+            }
+            return interpreter.evaluate(es->getExpr());
+        } catch (const std::string& err) {
+            throw std::runtime_error(err);
+        } catch (const char* err) {
+            throw std::runtime_error(err);
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include "../canvas/canvas.h"
+#include "../interpreter/interpreter.h"
+
+namespace Acalc {
+
+    // Stands in for a display when a session draws nowhere.
+    class NullCanvas : public Canvas {
+        public:
+            void plot(float, float) override {}
+            void line(float, float, float, float) override {}
+            void show() override {}
+            void hide() override {}
+            void clean() override {}
+            void exit() override {}
+    };
+
+    // One independent calculator: its own variables, memo cache, output
+    // stream and, optionally, canvas. The library keeps no global state, so
+    // separate sessions can run on separate threads without locking; a
+    // single session must only be used from one thread at a time. The one
+    // thing sessions do contend for is the cores: by default each one's
+    // implicit, table and integ statements start a worker per core, so hosts
+    // running a session per thread should pass options with workers = 1.
+    //
+    // Errors in a script are reported to the output stream and stop that
+    // script, as in the console. Each run starts with any earlier cancel()
+    // forgotten.
+    class Session {
+        public:
+            // Drawing goes to `sink`, or nowhere when it is null.
+            explicit Session(std::ostream& out = std::cout, Canvas* sink = nullptr, InterpreterOptions options = {})
+            : out{out}, interpreter{sink != nullptr ? *sink : none, out, options} {}
+
+            Session(const Session&) = delete;
+            Session& operator=(const Session&) = delete;
+
+            // Runs every statement in `code`. Returns false if one failed.
+            bool run(std::string_view code);
+            bool run(std::istream& code);
+
+            // run() forgets earlier cancels on entry, which loses one that
+            // arrives between a host marking the session busy and the call.
+            // Such hosts call prepare() before marking it and then
+            // runPrepared(), which forgets nothing.
+            void prepare() { interpreter.getProgress().reset(); }
+            bool runPrepared(std::string_view code);
+
+            // Runs a script file, through its precompiled cache when one is
+            // current and otherwise building the cache first.
+            bool runFile(const std::string& path);
+
+            // Evaluates a single expression. Errors are thrown as
+            // std::runtime_error rather than reported.
+            float evaluate(std::string_view expression);
+
+            bool exited() const { return interpreter.exited(); }
+
+            // Stops the statement now running at its next yield point, and
+            // the rest of its script, with "Error: cancelled". Variables
+            // defined so far are kept. Unlike the rest of the session, this
+            // and progress() may be called from any thread, and cancel()
+            // from a signal handler.
+            void cancel() { interpreter.getProgress().cancel(); }
+
+            // How far the running statement has got, in [0, 1], or negative
+            // when it is not measured.
+            float progress() const { return interpreter.getProgress().fraction(); }
+
+            Interpreter& getInterpreter() { return interpreter; }
+
+        private:
+            template <typename Source>
+            bool execute(Source&& next);
+
+            bool report(const std::string& message);
+
+        private:
+            NullCanvas none;
+            std::ostream& out;
+            Interpreter interpreter;
+    };
+}
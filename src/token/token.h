@@ -15,11 +15,13 @@ namespace Acalc {
         TOKEN_PLOT, TOKEN_CLEAR, TOKEN_EXIT,
 
         TOKEN_LINE, TOKEN_CLEAN, TOKEN_GRAPH,
+        TOKEN_PGRAPH, TOKEN_POLAR, TOKEN_IMPLICIT,
+        TOKEN_PRECISION, TOKEN_TABLE, TOKEN_INTO,
 
         TOKEN_PRINT, TOKEN_SEMICOLON, 
         TOKEN_INTEG, TOKEN_ABS,
 
-        TOKEN_IDENTIFIER, TOKEN_NUMBER,
+        TOKEN_IDENTIFIER, TOKEN_NUMBER, TOKEN_STRING,
 
         TOKEN_POWER, TOKEN_INT,
 